@@ -0,0 +1,278 @@
+#pragma once
+
+// Renders the cube and sphere previews of projects over a time range into
+// image sequences, without a window. Rendering stays on the calling thread,
+// PNG compression and file writes run on a thread pool.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "3rdparty/stb_image_write.h"
+
+#include "project_chunks.hpp"
+#include "evaluator.hpp"
+#include "thread_pool.hpp"
+#include "offscreen_context.hpp"
+#include "preview.hpp"
+#include "framebuffer.hpp"
+
+enum class BakeFormat
+{
+    png,
+    raw
+};
+
+struct BakeOptions
+{
+    float                    start = 0.f;
+    float                    end = 1.f;
+    float                    step = 1.f / 30.f;
+    int                      size = 256;
+    BakeFormat               format = BakeFormat::png;
+    std::string              output_dir = ".";
+    size_t                   jobs = std::thread::hardware_concurrency();
+    std::vector<std::string> projects;
+};
+
+inline void print_bake_usage()
+{
+    std::cerr << "usage: materialeditor --bake [options] project.json...\n"
+                 "  --start <seconds>  first frame time (default 0)\n"
+                 "  --end <seconds>    last frame time (default 1)\n"
+                 "  --step <seconds>   time between frames (default 1/30)\n"
+                 "  --size <pixels>    width and height of the images (default 256)\n"
+                 "  --format png|raw   image format (default png)\n"
+                 "  --output <dir>     image directory (default .)\n"
+                 "  --jobs <n>         encoder threads (default: all cores)\n"
+                 "\n"
+                 "Writes <project>_<viewport>_<frame>.png for every cube and sphere viewport.\n"
+                 "raw images are size * size RGBA8 pixels, top row first.\n";
+}
+
+inline bool parse_bake_options(int argc, char** argv, BakeOptions& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+
+        if (arg == "--bake")
+        {
+            continue;
+        }
+        else if (arg == "--start" && has_value)
+        {
+            options.start = std::stof(argv[++i]);
+        }
+        else if (arg == "--end" && has_value)
+        {
+            options.end = std::stof(argv[++i]);
+        }
+        else if (arg == "--step" && has_value)
+        {
+            options.step = std::stof(argv[++i]);
+        }
+        else if (arg == "--size" && has_value)
+        {
+            options.size = std::stoi(argv[++i]);
+        }
+        else if (arg == "--format" && has_value)
+        {
+            const std::string format = argv[++i];
+            if (format == "png")
+            {
+                options.format = BakeFormat::png;
+            }
+            else if (format == "raw")
+            {
+                options.format = BakeFormat::raw;
+            }
+            else
+            {
+                std::cerr << "Unknown format " << format << std::endl;
+                return false;
+            }
+        }
+        else if (arg == "--output" && has_value)
+        {
+            options.output_dir = argv[++i];
+        }
+        else if (arg == "--jobs" && has_value)
+        {
+            options.jobs = std::stoul(argv[++i]);
+        }
+        else if (!arg.empty() && arg[0] == '-')
+        {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return false;
+        }
+        else
+        {
+            options.projects.push_back(arg);
+        }
+    }
+
+    if (options.projects.empty() || options.step <= 0.f || options.end < options.start ||
+        options.size <= 0 || options.size > 8192)
+    {
+        return false;
+    }
+
+    return true;
+}
+
+// Runs on an encoder thread. The pixels come straight from glReadPixels, so
+// the bottom row is first.
+inline bool write_baked_image(
+    const std::string& path, const std::vector<unsigned char>& pixels, int size, BakeFormat format)
+{
+    const size_t stride = static_cast<size_t>(size) * 4;
+
+    if (format == BakeFormat::png)
+    {
+        if (!stbi_write_png(path.c_str(), size, size, 4, pixels.data(), static_cast<int>(stride)))
+        {
+            std::cerr << "Error: cannot write " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    std::ofstream file(path, std::ios::binary);
+    for (int row = size - 1; row >= 0 && file; --row)
+    {
+        file.write(reinterpret_cast<const char*>(pixels.data() + stride * row), static_cast<std::streamsize>(stride));
+    }
+    if (!file)
+    {
+        std::cerr << "Error: cannot write " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+inline int run_bake(int argc, char** argv)
+{
+    BakeOptions options;
+    try
+    {
+        if (!parse_bake_options(argc, argv, options))
+        {
+            print_bake_usage();
+            return 1;
+        }
+    }
+    catch (const std::exception&)
+    {
+        print_bake_usage();
+        return 1;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(options.output_dir, error);
+
+    // Declared first, so the GL objects below are released while it is current
+    OffscreenContext context;
+    if (!context.create())
+    {
+        return 1;
+    }
+
+    // glReadPixels returns the bottom row first
+    stbi_flip_vertically_on_write(1);
+
+    bool ok = true;
+    {
+        PreviewRenderer preview;
+        preview.wait_for_program();
+        FrameBuffer target;
+        target.InitFrameBuffer(options.size, options.size);
+
+        ThreadPool encoders(options.jobs);
+        // Bounds the memory held by frames waiting for an encoder
+        const size_t max_in_flight = encoders.size() * 2;
+        std::deque<std::future<bool>> in_flight;
+
+        for (const std::string& filename : options.projects)
+        {
+            Project project;
+            std::vector<Sink> sinks;
+            if (!load_project_file(project, filename) || !collect_sinks(project, sinks))
+            {
+                ok = false;
+                continue;
+            }
+
+            const std::string stem = std::filesystem::path(filename).stem().string();
+            const size_t frames = static_cast<size_t>((options.end - options.start) / options.step + 1e-4f) + 1;
+
+            for (size_t frame = 0; frame < frames; ++frame)
+            {
+                const float time = options.start + options.step * static_cast<float>(frame);
+                preview.begin_frame(time);
+
+                for (Sink& sink : sinks)
+                {
+                    if (sink.type != UiNodeType::cubeviewport && sink.type != UiNodeType::sphereviewport)
+                    {
+                        continue;
+                    }
+
+                    const Rgb rgb = evaluate_sink(sink, time);
+                    const glm::vec3 color(
+                        std::clamp(rgb.r, 0.f, 1.f), std::clamp(rgb.g, 0.f, 1.f), std::clamp(rgb.b, 0.f, 1.f));
+
+                    target.Bind();
+                    if (sink.type == UiNodeType::cubeviewport)
+                    {
+                        preview.render_to_framebuffer_cube(color, 0.f, 0.f, options.size, options.size);
+                    }
+                    else
+                    {
+                        preview.render_to_framebuffer_sphere(color, options.size, options.size);
+                    }
+                    target.Unbind();
+
+                    char name[32];
+                    std::snprintf(name, sizeof(name), "_%05zu", frame);
+                    const std::string path =
+                        (std::filesystem::path(options.output_dir) /
+                         (stem + "_" + sink.name + name + (options.format == BakeFormat::png ? ".png" : ".rgba")))
+                            .string();
+
+                    // The pixels arrive a few renders later, meanwhile the
+                    // next previews are drawn
+                    const BakeFormat format = options.format;
+                    target.ReadPixelsAsync(0, 0, options.size, options.size,
+                                           [&, path, format](std::vector<unsigned char>&& pixels, int size, int) {
+                        while (in_flight.size() >= max_in_flight)
+                        {
+                            ok = in_flight.front().get() && ok;
+                            in_flight.pop_front();
+                        }
+                        in_flight.push_back(encoders.submit([path, pixels = std::move(pixels), size, format] {
+                            return write_baked_image(path, pixels, size, format);
+                        }));
+                    });
+                    target.PollReadbacks();
+                }
+            }
+        }
+
+        target.PollReadbacks(true);
+        while (!in_flight.empty())
+        {
+            ok = in_flight.front().get() && ok;
+            in_flight.pop_front();
+        }
+    }
+
+    return ok ? 0 : 1;
+}
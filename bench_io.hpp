@@ -0,0 +1,303 @@
+#pragma once
+
+// Compares the project file formats on a generated project: plain JSON as
+// written by Export JSON, the chunked binary container, and the chunked
+// container with LZ4 compressed chunks.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "project_chunks.hpp"
+
+struct BenchIoOptions
+{
+    size_t      nodes = 100000;
+    size_t      repeat = 5;
+    size_t      threads = std::thread::hardware_concurrency();
+    // Simulated read bandwidth in MB/s, 0 for the disk's own
+    double      read_mbps = 0.0;
+    std::string output_dir = std::filesystem::temp_directory_path().string();
+};
+
+inline void print_bench_io_usage()
+{
+    std::cerr << "usage: materialeditor-headless --bench-io [options]\n"
+                 "  --nodes <n>      ui nodes in the generated project (default 100000)\n"
+                 "  --repeat <n>     loads per format, the median is reported (default 5)\n"
+                 "  --output <dir>   where the project files are written (default: temp dir)\n"
+                 "  --threads <n>    threads decoding the chunks (default: hardware threads)\n"
+                 "  --read-mbps <n>  reads no faster than n MB/s, like a network share (default: off)\n"
+                 "\n"
+                 "Load times include reading the file, so the directory decides whether\n"
+                 "local or network I/O is measured. The files are left in place.\n";
+}
+
+inline bool parse_bench_io_options(int argc, char** argv, BenchIoOptions& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+
+        if (arg == "--bench-io" || arg == "--headless")
+        {
+            continue;
+        }
+        else if (arg == "--nodes" && has_value)
+        {
+            options.nodes = std::stoul(argv[++i]);
+        }
+        else if (arg == "--repeat" && has_value)
+        {
+            options.repeat = std::stoul(argv[++i]);
+        }
+        else if (arg == "--output" && has_value)
+        {
+            options.output_dir = argv[++i];
+        }
+        else if (arg == "--threads" && has_value)
+        {
+            options.threads = std::stoul(argv[++i]);
+        }
+        else if (arg == "--read-mbps" && has_value)
+        {
+            options.read_mbps = std::stod(argv[++i]);
+        }
+        else
+        {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return false;
+        }
+    }
+
+    return options.nodes > 0 && options.repeat > 0 && options.read_mbps >= 0.0;
+}
+
+// Builds a project like the editor would: ui nodes with their value nodes
+// and edges, laid out on a grid, most inputs fed by one of the 256 nodes
+// before it, and an output node at the end.
+inline Project generate_benchmark_project(const size_t node_count, const unsigned seed = 1)
+{
+    Project project;
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> value(0.f, 1.f);
+
+    std::vector<int> producers;
+    const auto add_value = [&project, &value, &rng] {
+        return project.graph.insert_node(Node(NodeType::value, value(rng)));
+    };
+    const auto link_input = [&project, &producers, &rng](const int input) {
+        if (!producers.empty() && rng() % 4 != 0)
+        {
+            const size_t back = 1 + rng() % std::min<size_t>(producers.size(), 256);
+            project.graph.insert_edge(input, producers[producers.size() - back]);
+        }
+    };
+
+    for (size_t i = 0; i + 1 < node_count; ++i)
+    {
+        UiNode ui_node;
+        ui_node.x = static_cast<float>(i % 128) * 220.f;
+        ui_node.y = static_cast<float>(i / 128) * 160.f;
+
+        switch (rng() % 5)
+        {
+        case 0:
+            ui_node.type = UiNodeType::time;
+            ui_node.id = project.graph.insert_node(Node(NodeType::time));
+            break;
+        case 1:
+            ui_node.type = UiNodeType::sine;
+            ui_node.ui.sine.input = add_value();
+            ui_node.id = project.graph.insert_node(Node(NodeType::sine));
+            project.graph.insert_edge(ui_node.id, ui_node.ui.sine.input);
+            link_input(ui_node.ui.sine.input);
+            break;
+        default:
+        {
+            const int lhs = add_value();
+            const int rhs = add_value();
+            const NodeType op = rng() % 2 ? NodeType::add : NodeType::multiply;
+            ui_node.type = op == NodeType::add ? UiNodeType::add : UiNodeType::multiply;
+            ui_node.ui.add.lhs = lhs;
+            ui_node.ui.add.rhs = rhs;
+            ui_node.id = project.graph.insert_node(Node(op));
+            project.graph.insert_edge(ui_node.id, lhs);
+            project.graph.insert_edge(ui_node.id, rhs);
+            link_input(lhs);
+            link_input(rhs);
+        }
+        break;
+        }
+
+        producers.push_back(ui_node.id);
+        project.nodes.push_back(ui_node);
+    }
+
+    UiNode output;
+    output.type = UiNodeType::output;
+    output.ui.output.r = add_value();
+    output.ui.output.g = add_value();
+    output.ui.output.b = add_value();
+    output.id = project.graph.insert_node(Node(NodeType::output));
+    for (const int input : {output.ui.output.r, output.ui.output.g, output.ui.output.b})
+    {
+        project.graph.insert_edge(output.id, input);
+        link_input(input);
+    }
+    project.root_node_id = output.id;
+    project.nodes.push_back(output);
+
+    return project;
+}
+
+inline double median_milliseconds(const size_t repeat, const std::function<bool()>& function)
+{
+    std::vector<double> times;
+    for (size_t i = 0; i < repeat; ++i)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        if (!function())
+        {
+            return -1.0;
+        }
+        times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    std::sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+inline int run_bench_io(int argc, char** argv)
+{
+    BenchIoOptions options;
+    try
+    {
+        if (!parse_bench_io_options(argc, argv, options))
+        {
+            print_bench_io_usage();
+            return 1;
+        }
+    }
+    catch (const std::exception&)
+    {
+        print_bench_io_usage();
+        return 1;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(options.output_dir, error);
+
+    const Project project = generate_benchmark_project(options.nodes);
+    const Span<const int> graph_nodes = project.graph.node_ids();
+    const auto edges = project.graph.edges();
+    std::cout << "project: " << project.nodes.size() << " ui nodes, " << graph_nodes.end() - graph_nodes.begin()
+              << " graph nodes, " << edges.end() - edges.begin() << " edges" << std::endl;
+
+    struct Format
+    {
+        const char*                                          name;
+        std::string                                          filename;
+        std::function<bool(const Project&, const std::string&)> save;
+    };
+    const std::filesystem::path dir(options.output_dir);
+    const Format formats[] = {
+        {"json", (dir / "bench_io.json").string(), save_project_json},
+        {"binary", (dir / "bench_io.mep").string(),
+         [](const Project& p, const std::string& f) { return write_chunked_project(p, f); }},
+        {"binary+lz4", (dir / "bench_io_lz4.mep").string(),
+         [](const Project& p, const std::string& f) { return write_chunked_project(p, f, ChunkCodec::lz4); }},
+    };
+
+    ThreadPool decoders(options.threads);
+    const double read_bandwidth = options.read_mbps * 1e6;
+    std::cout << "decoding on " << decoders.size() << " threads, reading at ";
+    if (read_bandwidth > 0.0)
+    {
+        std::cout << options.read_mbps << " MB/s" << std::endl;
+    }
+    else
+    {
+        std::cout << "disk speed" << std::endl;
+    }
+
+    // Makes each read of a chunked file take as long as it would at the
+    // simulated bandwidth
+    const auto throttle = [read_bandwidth](ChunkedProjectReader& reader) {
+        if (read_bandwidth > 0.0)
+        {
+            reader.set_read_callback([read_bandwidth](const uint64_t bytes) {
+                std::this_thread::sleep_for(std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                    std::chrono::duration<double>(bytes / read_bandwidth)));
+            });
+        }
+    };
+
+    // JSON parses while the file streams in, so with a simulated bandwidth
+    // it takes the longer of parsing and transferring the file
+    const auto load_json = [&](Project& loaded, const std::string& filename) {
+        const auto start = std::chrono::steady_clock::now();
+        const bool loaded_ok = load_project_json(loaded, filename);
+        if (read_bandwidth > 0.0)
+        {
+            std::error_code size_error;
+            const double bytes = static_cast<double>(std::filesystem::file_size(filename, size_error));
+            std::this_thread::sleep_until(start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                                      std::chrono::duration<double>(bytes / read_bandwidth)));
+        }
+        return loaded_ok;
+    };
+
+    std::printf("%-12s %14s %12s %12s %12s\n", "format", "size [bytes]", "save [ms]", "load [ms]", "open [ms]");
+
+    bool ok = true;
+    for (const Format& format : formats)
+    {
+        const double save_ms = median_milliseconds(1, [&] { return format.save(project, format.filename); });
+
+        // A full load, as the headless tools do
+        const double load_ms = median_milliseconds(options.repeat, [&] {
+            Project loaded;
+            if (!is_chunked_project_file(format.filename))
+            {
+                return load_json(loaded, format.filename) && loaded.nodes.size() == project.nodes.size();
+            }
+            ChunkedProjectReader reader(&decoders);
+            throttle(reader);
+            return load_project_file(loaded, format.filename, reader) && loaded.nodes.size() == project.nodes.size();
+        });
+
+        // What the editor waits for before the first frame: chunked files
+        // only read the chunk with the output node
+        const double open_ms = median_milliseconds(options.repeat, [&] {
+            Project loaded;
+            if (!is_chunked_project_file(format.filename))
+            {
+                return load_json(loaded, format.filename);
+            }
+            ChunkedProjectReader reader(&decoders);
+            throttle(reader);
+            return reader.open(format.filename, loaded);
+        });
+
+        if (save_ms < 0.0 || load_ms < 0.0 || open_ms < 0.0)
+        {
+            std::cerr << "Error: " << format.name << " round trip failed." << std::endl;
+            ok = false;
+            continue;
+        }
+
+        std::printf("%-12s %14llu %12.1f %12.1f %12.1f\n", format.name,
+                    static_cast<unsigned long long>(std::filesystem::file_size(format.filename, error)), save_ms,
+                    load_ms, open_ms);
+    }
+
+    return ok ? 0 : 1;
+}
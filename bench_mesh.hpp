@@ -0,0 +1,177 @@
+#pragma once
+
+// Compares loading a mesh viewport's OBJ file by parsing it and by reading
+// the binary cache written next to it on the first load.
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "bench_io.hpp"
+#include "mesh_loader.hpp"
+
+struct BenchMeshOptions
+{
+    size_t      triangles = 1000000;
+    size_t      repeat = 5;
+    std::string output_dir = std::filesystem::temp_directory_path().string();
+};
+
+inline void print_bench_mesh_usage()
+{
+    std::cerr << "usage: materialeditor-headless --bench-mesh [options]\n"
+                 "  --triangles <n>  triangles of the generated mesh (default 1000000)\n"
+                 "  --repeat <n>     loads per variant, the median is reported (default 5)\n"
+                 "  --output <dir>   where the OBJ and its cache are written (default: temp dir)\n";
+}
+
+inline bool parse_bench_mesh_options(int argc, char** argv, BenchMeshOptions& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+
+        if (arg == "--bench-mesh" || arg == "--headless")
+        {
+            continue;
+        }
+        else if (arg == "--triangles" && has_value)
+        {
+            options.triangles = std::stoul(argv[++i]);
+        }
+        else if (arg == "--repeat" && has_value)
+        {
+            options.repeat = std::stoul(argv[++i]);
+        }
+        else if (arg == "--output" && has_value)
+        {
+            options.output_dir = argv[++i];
+        }
+        else
+        {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return false;
+        }
+    }
+
+    return options.triangles > 0 && options.repeat > 0;
+}
+
+// Writes a torus of about the requested number of triangles, with normals
+// and uvs shared between neighbouring faces as exporters write them
+inline bool write_benchmark_obj(const std::string& path, const size_t triangles)
+{
+    std::ofstream file(path);
+    if (!file.is_open())
+    {
+        std::cerr << "Error: cannot write " << path << std::endl;
+        return false;
+    }
+
+    const int rings = std::max(3, static_cast<int>(std::sqrt(triangles / 2.0)));
+    const int sides = std::max(3, static_cast<int>(triangles / 2 / rings));
+    const float pi = 3.14159265f;
+    char line[128];
+
+    for (int i = 0; i <= rings; ++i)
+    {
+        for (int j = 0; j <= sides; ++j)
+        {
+            const float u = 2.f * pi * i / rings;
+            const float v = 2.f * pi * j / sides;
+            const float nx = std::cos(v) * std::cos(u);
+            const float ny = std::sin(v);
+            const float nz = std::cos(v) * std::sin(u);
+            std::snprintf(line, sizeof(line), "v %.6f %.6f %.6f\n", std::cos(u) + 0.3f * nx, 0.3f * ny,
+                          std::sin(u) + 0.3f * nz);
+            file << line;
+            std::snprintf(line, sizeof(line), "vn %.6f %.6f %.6f\n", nx, ny, nz);
+            file << line;
+            std::snprintf(line, sizeof(line), "vt %.6f %.6f\n", float(i) / rings, float(j) / sides);
+            file << line;
+        }
+    }
+
+    const auto corner = [sides](const int i, const int j) { return i * (sides + 1) + j + 1; };
+    for (int i = 0; i < rings; ++i)
+    {
+        for (int j = 0; j < sides; ++j)
+        {
+            const int a = corner(i, j), b = corner(i + 1, j), c = corner(i + 1, j + 1), d = corner(i, j + 1);
+            std::snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, b, b, b, c, c, c);
+            file << line;
+            std::snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, c, c, c, d, d, d);
+            file << line;
+        }
+    }
+
+    return static_cast<bool>(file);
+}
+
+inline int run_bench_mesh(int argc, char** argv)
+{
+    BenchMeshOptions options;
+    try
+    {
+        if (!parse_bench_mesh_options(argc, argv, options))
+        {
+            print_bench_mesh_usage();
+            return 1;
+        }
+    }
+    catch (const std::exception&)
+    {
+        print_bench_mesh_usage();
+        return 1;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(options.output_dir, error);
+    const std::string path = (std::filesystem::path(options.output_dir) / "bench_mesh.obj").string();
+    if (!write_benchmark_obj(path, options.triangles))
+    {
+        return 1;
+    }
+
+    MeshData mesh;
+    std::string load_error;
+    size_t vertices = 0;
+    size_t triangles = 0;
+
+    // Every load parses, the cache is removed before each one
+    const double parse_ms = median_milliseconds(options.repeat, [&] {
+        std::filesystem::remove(mesh_cache_path(path), error);
+        MeshLoadInfo info;
+        const bool loaded = load_mesh(path, mesh, load_error, &info) && !info.from_cache;
+        vertices = mesh.vertices.size();
+        triangles = mesh.triangles();
+        return loaded;
+    });
+
+    // The last parse left a cache behind
+    const double cache_ms = median_milliseconds(options.repeat, [&] {
+        MeshLoadInfo info;
+        return load_mesh(path, mesh, load_error, &info) && info.from_cache && mesh.triangles() == triangles;
+    });
+
+    if (parse_ms < 0.0 || cache_ms < 0.0)
+    {
+        std::cerr << "Error: mesh load failed. " << load_error << std::endl;
+        return 1;
+    }
+
+    std::cout << "mesh: " << triangles << " triangles, " << vertices << " vertices after de-duplication"
+              << std::endl;
+    std::printf("%-12s %14s %12s\n", "source", "size [bytes]", "load [ms]");
+    std::printf("%-12s %14llu %12.1f\n", "obj",
+                static_cast<unsigned long long>(std::filesystem::file_size(path, error)), parse_ms);
+    std::printf("%-12s %14llu %12.1f\n", "cache",
+                static_cast<unsigned long long>(std::filesystem::file_size(mesh_cache_path(path), error)),
+                cache_ms);
+    return 0;
+}
@@ -0,0 +1,299 @@
+#pragma once
+
+// Renders previews in an offscreen context, once one by one into a
+// framebuffer as the viewports do and once batched into the thumbnail atlas.
+// Before timing, a few previews, also some drawn through a render graph, are
+// read back and compared with their expected colors, so the mode doubles as
+// a rendering check on machines without a display: it exits with 1 if any
+// pixel is wrong.
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_io.hpp"
+#include "offscreen_context.hpp"
+#include "preview.hpp"
+#include "framebuffer.hpp"
+#include "gpu_timer.hpp"
+#include "render_graph.hpp"
+#include "render_target_pool.hpp"
+#include "thumbnail_atlas.hpp"
+
+struct BenchPreviewsOptions
+{
+    size_t previews = 64;
+    size_t frames = 20;
+    int    size = 256;
+};
+
+inline void print_bench_previews_usage()
+{
+    std::cerr << "usage: materialeditor --bench-previews [options]\n"
+                 "  --previews <n>   previews per frame, half cubes and half spheres (default 64)\n"
+                 "  --frames <n>     frames per variant, the median is reported (default 20)\n"
+                 "  --size <pixels>  size of the framebuffer previews (default 256)\n";
+}
+
+inline bool parse_bench_previews_options(int argc, char** argv, BenchPreviewsOptions& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+
+        if (arg == "--bench-previews")
+        {
+            continue;
+        }
+        else if (arg == "--previews" && has_value)
+        {
+            options.previews = std::stoul(argv[++i]);
+        }
+        else if (arg == "--frames" && has_value)
+        {
+            options.frames = std::stoul(argv[++i]);
+        }
+        else if (arg == "--size" && has_value)
+        {
+            options.size = std::stoi(argv[++i]);
+        }
+        else
+        {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return false;
+        }
+    }
+
+    return options.previews > 0 && options.frames > 0 && options.size > 0 && options.size <= 8192;
+}
+
+// Pure red, green and blue, so the lit center of a preview reads back exactly
+inline glm::vec3 bench_preview_color(const size_t index)
+{
+    return glm::vec3(index % 3 == 0 ? 1.f : 0.f, index % 3 == 1 ? 1.f : 0.f, index % 3 == 2 ? 1.f : 0.f);
+}
+
+// Compares the pixel at x, y of the bound read framebuffer with color
+inline bool check_preview_pixel(const char* what, const int x, const int y, const glm::vec3& color)
+{
+    unsigned char pixel[4] = {};
+    glReadPixels(x, y, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixel);
+    const int expected[3] = {int(color.r * 255.f), int(color.g * 255.f), int(color.b * 255.f)};
+    if (pixel[0] == expected[0] && pixel[1] == expected[1] && pixel[2] == expected[2])
+    {
+        return true;
+    }
+    std::cerr << "[WARN] " << what << ": pixel " << int(pixel[0]) << " " << int(pixel[1]) << " " << int(pixel[2])
+              << ", expected " << expected[0] << " " << expected[1] << " " << expected[2] << std::endl;
+    return false;
+}
+
+inline int run_bench_previews(int argc, char** argv)
+{
+    BenchPreviewsOptions options;
+    try
+    {
+        if (!parse_bench_previews_options(argc, argv, options))
+        {
+            print_bench_previews_usage();
+            return 1;
+        }
+    }
+    catch (const std::exception&)
+    {
+        print_bench_previews_usage();
+        return 1;
+    }
+
+    // Declared first, so the GL objects below are released while it is current
+    OffscreenContext context;
+    if (!context.create())
+    {
+        return 1;
+    }
+
+    bool ok = true;
+    double direct_ms = 0.0;
+    double atlas_ms = 0.0;
+    std::vector<GpuPassTime> gpu_times;
+    {
+        PreviewRenderer preview;
+        preview.wait_for_program();
+        FrameBuffer target;
+        target.InitFrameBuffer(options.size, options.size);
+        RenderTargetPool targets;
+        ThumbnailAtlas atlas(preview, targets);
+        GpuTimer timer;
+
+        preview.begin_frame(0.f);
+        const int center = options.size / 2;
+        target.Bind();
+        preview.render_to_framebuffer_cube(bench_preview_color(0), 0.3f, 0.2f, options.size, options.size);
+        ok = check_preview_pixel("cube", center, center, bench_preview_color(0)) && ok;
+        preview.render_to_framebuffer_sphere(bench_preview_color(1), options.size, options.size);
+        ok = check_preview_pixel("sphere", center, center, bench_preview_color(1)) && ok;
+        target.Unbind();
+
+        // Cube and sphere go through transients that are copied side by side
+        // into a sheet. The transients are never used at the same time, so
+        // they share one target, and the pass nobody reads is culled.
+        {
+            FrameBuffer sheet;
+            sheet.InitFrameBuffer(2 * options.size, options.size);
+            RenderGraph graph(targets);
+            const RenderResource output = graph.import("sheet");
+            const auto copy_to_sheet = [&](const RenderResource source, const int x) {
+                graph.bind(source);
+                glBindTexture(GL_TEXTURE_2D, sheet.getFrameTexture());
+                glCopyTexSubImage2D(GL_TEXTURE_2D, 0, x, 0, 0, 0, options.size, options.size);
+                glBindTexture(GL_TEXTURE_2D, 0);
+            };
+            const RenderResource cube = graph.create("cube", options.size, options.size);
+            graph.add_pass("cube", {}, {cube}, [&] {
+                graph.bind(cube);
+                preview.render_to_framebuffer_cube(bench_preview_color(0), 0.3f, 0.2f, options.size, options.size);
+            });
+            graph.add_pass("copy cube", {cube}, {output}, [&] { copy_to_sheet(cube, 0); });
+            bool unused_ran = false;
+            const RenderResource unused = graph.create("unused", options.size, options.size);
+            graph.add_pass("unused", {}, {unused}, [&] { unused_ran = true; });
+            const RenderResource sphere = graph.create("sphere", options.size, options.size);
+            graph.add_pass("sphere", {}, {sphere}, [&] {
+                graph.bind(sphere);
+                preview.render_to_framebuffer_sphere(bench_preview_color(1), options.size, options.size);
+            });
+            graph.add_pass("copy sphere", {sphere}, {output}, [&] { copy_to_sheet(sphere, options.size); });
+            graph.present(output);
+            graph.execute();
+
+            const RenderGraphStats& stats = graph.stats();
+            if (unused_ran || stats.passes != 4 || stats.culled != 1 || stats.transients != 2 || stats.targets != 1)
+            {
+                std::cerr << "[WARN] render graph: " << stats.passes << " passes, " << stats.culled << " culled, "
+                          << stats.transients << " transients in " << stats.targets
+                          << " targets, expected 4, 1, 2 in 1" << std::endl;
+                ok = false;
+            }
+            sheet.Bind();
+            ok = check_preview_pixel("render graph cube", center, center, bench_preview_color(0)) && ok;
+            ok = check_preview_pixel("render graph sphere", options.size + center, center, bench_preview_color(1)) &&
+                 ok;
+            sheet.Unbind();
+        }
+
+        // The atlas compiles its program in the background, flush() keeps
+        // the previews queued until it is linked
+        std::vector<ThumbnailAtlas::Region> regions(options.previews);
+        const auto request_all = [&](const size_t frame, const float brightness) {
+            for (size_t i = 0; i < options.previews; ++i)
+            {
+                const glm::vec3 color = bench_preview_color(i + frame) * brightness;
+                regions[i] = atlas.request(static_cast<int>(i), i % 2 ? atlas.sphere_key(color)
+                                                                       : atlas.cube_key(color, 0.3f, 0.2f));
+            }
+        };
+        request_all(0, 1.f);
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+        atlas.flush();
+        while (atlas.stats().thumbnails_drawn == 0)
+        {
+            if (std::chrono::steady_clock::now() > deadline)
+            {
+                std::cerr << "Error: the thumbnail program did not link." << std::endl;
+                return 1;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            atlas.flush();
+        }
+
+        GLuint fbo = 0;
+        glGenFramebuffers(1, &fbo);
+        GlState::instance().bind_framebuffer(GL_FRAMEBUFFER, fbo);
+        for (size_t i = 0; i < options.previews; ++i)
+        {
+            const ThumbnailAtlas::Region& region = regions[i];
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, region.texture, 0);
+            const int x = static_cast<int>((region.uv0.x + region.uv1.x) * 0.5f * ThumbnailAtlas::page_size);
+            const int y = static_cast<int>((region.uv0.y + region.uv1.y) * 0.5f * ThumbnailAtlas::page_size);
+            const std::string what = "atlas cell " + std::to_string(i);
+            ok = check_preview_pixel(what.c_str(), x, y, bench_preview_color(i)) && ok;
+        }
+        GlState::instance().bind_framebuffer(GL_FRAMEBUFFER, 0);
+        GlState::instance().deleted_framebuffer(fbo);
+        glDeleteFramebuffers(1, &fbo);
+
+        // Colors change every frame, so every preview is drawn again. They
+        // are dimmed to differ from the checked ones in the first frame too.
+        // glFinish() makes the times include the GPU work.
+        size_t frame = 0;
+        direct_ms = median_milliseconds(options.frames, [&] {
+            ++frame;
+            preview.begin_frame(static_cast<float>(frame));
+            timer.begin_frame();
+            GpuTimer::Scope pass(timer, "framebuffer");
+            target.Bind();
+            for (size_t i = 0; i < options.previews; ++i)
+            {
+                const glm::vec3 color = bench_preview_color(i + frame);
+                if (i % 2)
+                {
+                    preview.render_to_framebuffer_sphere(color, options.size, options.size);
+                }
+                else
+                {
+                    preview.render_to_framebuffer_cube(color, 0.3f, 0.2f, options.size, options.size);
+                }
+            }
+            target.Unbind();
+            timer.end();
+            glFinish();
+            return glGetError() == GL_NO_ERROR;
+        });
+
+        atlas_ms = median_milliseconds(options.frames, [&] {
+            ++frame;
+            preview.begin_frame(static_cast<float>(frame));
+            request_all(frame, 0.5f);
+            timer.begin_frame();
+            GpuTimer::Scope pass(timer, "atlas");
+            atlas.flush();
+            timer.end();
+            glFinish();
+            return atlas.stats().thumbnails_drawn == options.previews && glGetError() == GL_NO_ERROR;
+        });
+        // Collects the last frame
+        timer.begin_frame();
+        gpu_times = timer.passes();
+    }
+
+    if (direct_ms < 0.0 || atlas_ms < 0.0)
+    {
+        std::cerr << "Error: rendering failed." << std::endl;
+        return 1;
+    }
+
+    std::cout << "renderer: " << context.renderer() << ", " << options.previews << " previews per frame"
+              << std::endl;
+    // GPU times are averages, "-" without timer queries
+    const auto gpu_ms = [&](const char* name) {
+        for (const GpuPassTime& pass : gpu_times)
+        {
+            if (pass.name == name)
+            {
+                char text[32];
+                std::snprintf(text, sizeof(text), "%.2f", pass.average);
+                return std::string(text);
+            }
+        }
+        return std::string("-");
+    };
+    std::printf("%-12s %10s %12s %10s\n", "variant", "size [px]", "frame [ms]", "gpu [ms]");
+    std::printf("%-12s %10d %12.2f %10s\n", "framebuffer", options.size, direct_ms, gpu_ms("framebuffer").c_str());
+    std::printf("%-12s %10d %12.2f %10s\n", "atlas", ThumbnailAtlas::cell_size, atlas_ms, gpu_ms("atlas").c_str());
+    std::cout << "check: " << (ok ? "ok" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
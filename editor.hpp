@@ -1,8 +1,10 @@
 #pragma once
 
+#include <cstdio>
 #include <vector>
 #include <sstream>
 #include <algorithm>
+#include <unordered_map>
 #include <unordered_set>
 #include <nlohmann/json.hpp>
 #include <fstream>
@@ -14,9 +16,19 @@
 #include "node.hpp"
 #include "link.hpp"
 #include "graph.hpp"
-#include "object.hpp"
-#include "shader.hpp"
+#include "project.hpp"
+#include "project_chunks.hpp"
+#include "evaluator.hpp"
+#include "preview.hpp"
+#include "mesh_library.hpp"
+#include "texture_library.hpp"
 #include "framebuffer.hpp"
+#include "gl_state.hpp"
+#include "gpu_timer.hpp"
+#include "preview_resolution.hpp"
+#include "render_graph.hpp"
+#include "render_target_pool.hpp"
+#include "thumbnail_atlas.hpp"
 
 template<class T>
 T clamp(T x, T a, T b)
@@ -31,39 +43,70 @@ class NodeEditor
 {
 public:
     NodeEditor()
-        : graph_(), nodes_(), root_node_id_(-1),
+        : meshes_(preview_.meshes()),
+        thumbnails_(preview_, targets_),
+        render_graph_(targets_),
+        project_(),
         minimap_location_(ImNodesMiniMapLocation_BottomRight)
     {
 
-        setupSphere(1.0f, 16, 16);
-        frameBuffer.InitFrameBuffer(800,600);
-        frameBUfferSphere.InitFrameBuffer(800, 600);
-        mainShader.loadShader(shaderVertex, TypeShader::VERTEX_SHADER);
-        mainShader.loadShader(shaderFragment, TypeShader::FRAGMENT_SHADER);
-        mainShader.createShaderProgram();
-
-        // first viewer is cube.
-        frameBuffer.Bind();
-        render_to_framebuffer_cube(glm::vec3(1.0f, 0.5f, 0.31f));
-        frameBuffer.Unbind();
+        frameBuffer.ResizeToFit(800, 600);
     }
 
 private:
-    unsigned int fbo;      // Framebuffer Object
-    unsigned int texture;
-    unsigned int rbo, ebo;
-    unsigned int cubeVAO, cubeVBO = 0;
-    unsigned int sphereVAO, sphereVBO = 0;
-    Shader mainShader;
+    PreviewRenderer preview_;
+    // Files of the mesh viewports, uploaded into the preview meshes
+    MeshLibrary meshes_;
+    // Images of the texture nodes
+    TextureLibrary textures_;
     FrameBuffer frameBuffer;
-    FrameBuffer frameBUfferSphere;
+    // The 3d view shows the cube of the last drawn cube viewport
+    PreviewKey frameBufferKey_;
+    glm::vec3 viewColor_ = glm::vec3(1.0f, 0.5f, 0.31f);
 
-    int m_latitudeSegments = 0;
-    int m_longitudeSegments = 0;
+    // The viewport nodes show their previews from atlas pages of the pool
+    RenderTargetPool targets_;
+    ThumbnailAtlas   thumbnails_;
+    // The preview passes of the frame, those whose results are not shown
+    // are skipped
+    RenderGraph      render_graph_;
+
+    // GPU time of the preview passes and of the ImGui draw in main()
+    GpuTimer gpu_timer_;
+
+    // Size the node previews are drawn at this frame, for 200x200 points
+    // scaled by the frame budget
+    PreviewResolution resolution_;
+    int               preview_pixels_ = ThumbnailAtlas::cell_size;
 
     float rotationY = 0;
     float rotationX = 0;
 
+    // Where a node's attributes were last drawn, relative to the top left of
+    // its content
+    struct PinLayout
+    {
+        int    id = 0;
+        bool   output = false;
+        ImVec2 offset;
+        ImVec2 size;
+    };
+
+    struct NodeLayout
+    {
+        ImVec2                 title;
+        ImVec2                 content;
+        std::vector<PinLayout> pins;
+        // Of the whole node, its bounds in grid space start at its position
+        ImVec2                 size;
+
+        bool overlaps(const ImVec2& position, const ImVec2& min, const ImVec2& max) const
+        {
+            return position.x + size.x >= min.x && position.x <= max.x && position.y + size.y >= min.y &&
+                   position.y <= max.y;
+        }
+    };
+
 public:
 
     uint32_t getTicks() {
@@ -73,115 +116,6 @@ public:
         return static_cast<uint32_t>(elapsed);
     }
 
-
-    void renderCube(const glm::vec3& color, const glm::mat4& projection, const glm::mat4& view, const glm::mat4& model) {
-        // if(cubeVAO == 0) {
-        glGenVertexArrays(1, &cubeVAO);
-        glGenBuffers(1, &cubeVBO);
-
-        glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(CubeVertices), CubeVertices, GL_STATIC_DRAW);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(CubeIndices), CubeIndices, GL_STATIC_DRAW);
-
-        glBindVertexArray(cubeVAO);
-
-
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
-
-
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-        glEnableVertexAttribArray(1);
-
-
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-        glEnableVertexAttribArray(2);
-
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindVertexArray(0);
-        // }
-
-
-        mainShader.useShaderProgram();
-        glUniformMatrix4fv(glGetUniformLocation(mainShader.getShaderProgram(), "projection"), 1, GL_FALSE, &projection[0][0]);
-        glUniformMatrix4fv(glGetUniformLocation(mainShader.getShaderProgram(), "view"), 1, GL_FALSE, &view[0][0]);
-        glUniformMatrix4fv(glGetUniformLocation(mainShader.getShaderProgram(), "model"), 1, GL_FALSE, &model[0][0]);
-        glUniform3fv(glGetUniformLocation(mainShader.getShaderProgram(), "color"), 1, &color[0]);
-        glBindVertexArray(cubeVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
-    }
-
-    void setupSphere(float radius, int latitudeSegments, int longitudeSegments) {
-        auto vertices = generateSphere(radius, latitudeSegments, longitudeSegments);
-
-        m_latitudeSegments = latitudeSegments;
-        m_longitudeSegments = longitudeSegments;
-
-        glGenVertexArrays(1, &sphereVAO);
-        glGenBuffers(1, &sphereVBO);
-
-        glBindVertexArray(sphereVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, sphereVBO);
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);                     // Pozice
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(3 * sizeof(float)));  // Normály
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(6 * sizeof(float)));  // UV
-        glEnableVertexAttribArray(2);
-
-        glBindVertexArray(0);
-
-
-    }
-
-    void renderSphere(const glm::mat4& projection, const glm::mat4& view, const glm::mat4& model, const glm::vec3& color) {
-        mainShader.useShaderProgram();
-        glUniformMatrix4fv(glGetUniformLocation(mainShader.getShaderProgram(), "projection"), 1, GL_FALSE, &projection[0][0]);
-        glUniformMatrix4fv(glGetUniformLocation(mainShader.getShaderProgram(), "view"), 1, GL_FALSE, &view[0][0]);
-        glUniformMatrix4fv(glGetUniformLocation(mainShader.getShaderProgram(), "model"), 1, GL_FALSE, &model[0][0]);
-        glUniform3fv(glGetUniformLocation(mainShader.getShaderProgram(), "color"), 1, &color[0]);
-
-        glBindVertexArray(sphereVAO);
-        glDrawArrays(GL_TRIANGLE_STRIP, 0, (m_latitudeSegments + 1) * (m_longitudeSegments + 1));
-        glBindVertexArray(0);
-    }
-
-    void render_to_framebuffer_cube(glm::vec3 color)
-    {
-        glViewport(0, 0, 800, 600);
-        glEnable(GL_DEPTH_TEST);
-
-        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
-        glm::mat4 view = glm::lookAt(glm::vec3(3.0f, 3.0f, 3.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::rotate(model, rotationY, glm::vec3(0.0f, 1.0f, 0.0f));
-        model = glm::rotate(model, rotationX, glm::vec3(1.0f, 0.0f, 0.0f));
-        renderCube(color, projection, view, model);
-    }
-
-    void render_to_framebuffer_sphere(glm::vec3 color) {
-
-        glViewport(0, 0, 800, 600);
-        glEnable(GL_DEPTH_TEST);
-
-        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
-        glm::mat4 view = glm::lookAt(glm::vec3(3.0f, 3.0f, 3.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        glm::mat4 model = glm::mat4(1.0f);
-
-        renderSphere(projection, view, model, color);
-    }
-
     void handleMouseInput()
     {
         if (ImGui::IsMouseDragging(ImGuiMouseButton_Right))
@@ -195,146 +129,90 @@ public:
 
     void save_project(const std::string& filename)
     {
-        nlohmann::json j;
-
-        // Uložení uzlů
-        j["nodes"] =  nlohmann::json::array();
-        for (const auto& node : nodes_)
+        // Chunks that were never opened have to be read before the file is
+        // rewritten. Writing without the ones that cannot be read would drop
+        // their nodes from the file.
+        if (reader_.is_open())
         {
-            nlohmann::json  node_json;
-            node_json["id"] = node.id;
-            node_json["type"] = static_cast<int>(node.type);
-
-            switch (node.type)
+            const bool complete = reader_.materialize_all();
+            place_new_nodes();
+            if (!complete)
             {
-            case UiNodeType::add:
-                node_json["lhs"] = node.ui.add.lhs;
-                node_json["rhs"] = node.ui.add.rhs;
-                break;
-            case UiNodeType::multiply:
-                node_json["lhs"] = node.ui.multiply.lhs;
-                node_json["rhs"] = node.ui.multiply.rhs;
-                break;
-            case UiNodeType::power:
-                node_json["lhs"] = node.ui.power.lhs;
-                node_json["rhs"] = node.ui.power.rhs;
-                break;
-            case UiNodeType::output:
-                node_json["r"] = node.ui.output.r;
-                node_json["g"] = node.ui.output.g;
-                node_json["b"] = node.ui.output.b;
-                break;
-            case UiNodeType::sine:
-                node_json["input"] = node.ui.sine.input;
-                break;
-            case UiNodeType::cubeviewport:
-                node_json["input"] = node.ui.cubeviewport.input;
-                break;
-            case UiNodeType::sphereviewport:
-                node_json["input"] = node.ui.sphereviewport.input;
-                break;
-            default:
-                break;
+                std::cerr << "Error: the project could not be read completely, not saving " << filename
+                          << std::endl;
+                return;
             }
-
-            j["nodes"].push_back(node_json);
+            reader_.close();
         }
 
-        j["edges"] = nlohmann::json ::array();
-        for (const auto& edge : graph_.edges())
+        for (UiNode& node : project_.nodes)
         {
-            nlohmann::json  edge_json;
-            edge_json["id"] = edge.id;
-            edge_json["from"] = edge.from;
-            edge_json["to"] = edge.to;
-            j["edges"].push_back(edge_json);
+            const ImVec2 pos = ImNodes::GetNodeGridSpacePos(node.id);
+            node.x = pos.x;
+            node.y = pos.y;
         }
 
-        std::ofstream file(filename);
-        if (file.is_open())
+        const bool saved = filename.size() > 5 && filename.compare(filename.size() - 5, 5, ".json") == 0
+                               ? save_project_json(project_, filename)
+                               : write_chunked_project(project_, filename,
+                                                       compress_projects_ ? ChunkCodec::lz4 : ChunkCodec::none);
+        if (saved)
         {
-            file << j.dump(4);
-            file.close();
             std::cout << "Project save to: " << filename << std::endl;
         }
-        else
-        {
-            std::cerr << "save file failed!" << std::endl;
-        }
     }
 
 
     void load_project(const std::string& filename)
     {
-    std::ifstream file(filename);
-        if (!file.is_open())
+        reader_.close();
+        thumbnails_.release_all();
+        node_layouts_.clear();
+        texture_means_pending_.clear();
+        meshes_.clear();
+        textures_.clear();
+
+        // Chunked projects only read what is visible or needed for evaluation
+        const bool loaded = is_chunked_project_file(filename) ? reader_.open(filename, project_)
+                                                              : load_project_json(project_, filename);
+        if (loaded)
         {
-            std::cerr << "read file failed!" << std::endl;
-            return;
+            std::cout << "Project loaded from: " << filename << std::endl;
         }
 
-        nlohmann::json  j;
-        file >> j;
-
-        nodes_.clear();
-        graph_ = Graph<Node>();
-
-        for (const auto& node_json : j["nodes"])
+        for (const UiNode& node : project_.nodes)
         {
-            UiNode ui_node;
-            ui_node.id = node_json["id"];
-            ui_node.type = static_cast<UiNodeType>(node_json["type"]);
-
-            switch (ui_node.type)
-            {
-            case UiNodeType::add:
-                ui_node.ui.add.lhs = node_json["lhs"];
-                ui_node.ui.add.rhs = node_json["rhs"];
-                break;
-            case UiNodeType::multiply:
-                ui_node.ui.multiply.lhs = node_json["lhs"];
-                ui_node.ui.multiply.rhs = node_json["rhs"];
-                break;
-            case UiNodeType::power:
-                ui_node.ui.power.lhs = node_json["lhs"];
-                ui_node.ui.power.rhs = node_json["rhs"];
-                break;
-            case UiNodeType::output:
-                ui_node.ui.output.r = node_json["r"];
-                ui_node.ui.output.g = node_json["g"];
-                ui_node.ui.output.b = node_json["b"];
-                break;
-            case UiNodeType::sine:
-                ui_node.ui.sine.input = node_json["input"];
-                break;
-            case UiNodeType::cubeviewport:
-                ui_node.ui.cubeviewport.input = node_json["input"];
-                break;
-            case UiNodeType::sphereviewport:
-                ui_node.ui.sphereviewport.input = node_json["input"];
-                break;
-            default:
-                break;
-            }
-
-            nodes_.push_back(ui_node);
+            ImNodes::SetNodeGridSpacePos(node.id, ImVec2(node.x, node.y));
         }
+        reader_.take_new_nodes();
+    }
 
-        for (const auto& edge_json : j["edges"])
+    // Reads the chunks of a partially loaded project that intersect the
+    // visible part of the node canvas
+    void materialize_visible_chunks(const ImVec2& canvas_size)
+    {
+        if (!reader_.is_open())
         {
-            int from = edge_json["from"];
-            int to = edge_json["to"];
+            return;
+        }
 
-            if (!graph_.node_exists(from) || !graph_.node_exists(to))
+        const ImVec2 panning = ImNodes::EditorContextGetPanning();
+        reader_.materialize_region(-panning.x, -panning.y, -panning.x + canvas_size.x, -panning.y + canvas_size.y);
+        place_new_nodes();
+    }
+
+    void place_new_nodes()
+    {
+        for (const int id : reader_.take_new_nodes())
+        {
+            auto iter = std::find_if(project_.nodes.begin(), project_.nodes.end(), [id](const UiNode& node) {
+                return node.id == id;
+            });
+            if (iter != project_.nodes.end())
             {
-                std::cerr << "Error: Invalid edge. Missing nodes: " << from << " or " << to << std::endl;
-                continue; // Přeskočte chybnou hranu
+                ImNodes::SetNodeGridSpacePos(id, ImVec2(iter->x, iter->y));
             }
-
-            graph_.insert_edge(from, to);
         }
-
-        std::cout << "Project save to file!" << filename << std::endl;
     }
 
 
@@ -342,8 +220,24 @@ public:
     {
         handleMouseInput();
 
+        // The last frame took longer than it had to if the loop waited for input
+        const ImGuiIO& io = ImGui::GetIO();
+        const bool interacting = ImGui::IsAnyMouseDown() || io.MouseWheel != 0.f;
+        resolution_.update(io.DeltaTime * 1000.f, animating_ || interacting, !was_idle_);
+        preview_pixels_ = resolution_.pixels(200.f * io.DisplayFramebufferScale.y);
+
         // Update timer context
         current_time_seconds = 0.001f *  getTicks();
+        animating_ = false;
+        GlState::instance().begin_frame();
+        gpu_timer_.begin_frame();
+        preview_.begin_frame(current_time_seconds);
+        meshes_.poll();
+        {
+            GpuTimer::Scope pass(gpu_timer_, "texture upload");
+            textures_.poll();
+        }
+        update_texture_means();
 
         auto flags = ImGuiWindowFlags_MenuBar;
 
@@ -357,12 +251,22 @@ public:
             {
                 if (ImGui::MenuItem("Save"))
                 {
-                    save_project("project.json");
+                    save_project("project.mep");
                 }
                 if (ImGui::MenuItem("Load"))
+                {
+                    load_project("project.mep");
+                }
+                if (ImGui::MenuItem("Export JSON"))
+                {
+                    save_project("project.json");
+                }
+                if (ImGui::MenuItem("Import JSON"))
                 {
                     load_project("project.json");
                 }
+                ImGui::Separator();
+                ImGui::MenuItem("Compress on save", nullptr, &compress_projects_);
                 ImGui::EndMenu();
             }
 
@@ -410,6 +314,13 @@ public:
                 ImGui::EndMenu();
             }
 
+            if (ImGui::BeginMenu("View"))
+            {
+                ImGui::MenuItem("Statistics", nullptr, &show_statistics_);
+                ImGui::MenuItem("GPU times", nullptr, &show_gpu_times_);
+                ImGui::EndMenu();
+            }
+
             ImGui::EndMenuBar();
         }
 
@@ -425,6 +336,9 @@ public:
         }
         ImGui::Columns(1);
 
+        const ImVec2 canvas_size = ImGui::GetContentRegionAvail();
+        materialize_visible_chunks(canvas_size);
+
         ImNodes::BeginNodeEditor();
 
         // Handle new nodes
@@ -450,14 +364,14 @@ public:
 
                     UiNode ui_node;
                     ui_node.type = UiNodeType::add;
-                    ui_node.ui.add.lhs = graph_.insert_node(value);
-                    ui_node.ui.add.rhs = graph_.insert_node(value);
-                    ui_node.id = graph_.insert_node(op);
+                    ui_node.ui.add.lhs = project_.graph.insert_node(value);
+                    ui_node.ui.add.rhs = project_.graph.insert_node(value);
+                    ui_node.id = project_.graph.insert_node(op);
 
-                    graph_.insert_edge(ui_node.id, ui_node.ui.add.lhs);
-                    graph_.insert_edge(ui_node.id, ui_node.ui.add.rhs);
+                    project_.graph.insert_edge(ui_node.id, ui_node.ui.add.lhs);
+                    project_.graph.insert_edge(ui_node.id, ui_node.ui.add.rhs);
 
-                    nodes_.push_back(ui_node);
+                    project_.nodes.push_back(ui_node);
                     ImNodes::SetNodeScreenSpacePos(ui_node.id, click_pos);
                 }
 
@@ -468,36 +382,36 @@ public:
 
                     UiNode ui_node;
                     ui_node.type = UiNodeType::multiply;
-                    ui_node.ui.multiply.lhs = graph_.insert_node(value);
-                    ui_node.ui.multiply.rhs = graph_.insert_node(value);
-                    ui_node.id = graph_.insert_node(op);
+                    ui_node.ui.multiply.lhs = project_.graph.insert_node(value);
+                    ui_node.ui.multiply.rhs = project_.graph.insert_node(value);
+                    ui_node.id = project_.graph.insert_node(op);
 
-                    graph_.insert_edge(ui_node.id, ui_node.ui.multiply.lhs);
-                    graph_.insert_edge(ui_node.id, ui_node.ui.multiply.rhs);
+                    project_.graph.insert_edge(ui_node.id, ui_node.ui.multiply.lhs);
+                    project_.graph.insert_edge(ui_node.id, ui_node.ui.multiply.rhs);
 
-                    nodes_.push_back(ui_node);
+                    project_.nodes.push_back(ui_node);
                     ImNodes::SetNodeScreenSpacePos(ui_node.id, click_pos);
                 }
 
-                if (ImGui::MenuItem("output") && root_node_id_ == -1)
+                if (ImGui::MenuItem("output") && project_.root_node_id == -1)
                 {
                     const Node value(NodeType::value, 0.f);
                     const Node out(NodeType::output);
 
                     UiNode ui_node;
                     ui_node.type = UiNodeType::output;
-                    ui_node.ui.output.r = graph_.insert_node(value);
-                    ui_node.ui.output.g = graph_.insert_node(value);
-                    ui_node.ui.output.b = graph_.insert_node(value);
-                    ui_node.id = graph_.insert_node(out);
+                    ui_node.ui.output.r = project_.graph.insert_node(value);
+                    ui_node.ui.output.g = project_.graph.insert_node(value);
+                    ui_node.ui.output.b = project_.graph.insert_node(value);
+                    ui_node.id = project_.graph.insert_node(out);
 
-                    graph_.insert_edge(ui_node.id, ui_node.ui.output.r);
-                    graph_.insert_edge(ui_node.id, ui_node.ui.output.g);
-                    graph_.insert_edge(ui_node.id, ui_node.ui.output.b);
+                    project_.graph.insert_edge(ui_node.id, ui_node.ui.output.r);
+                    project_.graph.insert_edge(ui_node.id, ui_node.ui.output.g);
+                    project_.graph.insert_edge(ui_node.id, ui_node.ui.output.b);
 
-                    nodes_.push_back(ui_node);
+                    project_.nodes.push_back(ui_node);
                     ImNodes::SetNodeScreenSpacePos(ui_node.id, click_pos);
-                    root_node_id_ = ui_node.id;
+                    project_.root_node_id = ui_node.id;
                 }
 
                 if (ImGui::MenuItem("sine"))
@@ -507,12 +421,12 @@ public:
 
                     UiNode ui_node;
                     ui_node.type = UiNodeType::sine;
-                    ui_node.ui.sine.input = graph_.insert_node(value);
-                    ui_node.id = graph_.insert_node(op);
+                    ui_node.ui.sine.input = project_.graph.insert_node(value);
+                    ui_node.id = project_.graph.insert_node(op);
 
-                    graph_.insert_edge(ui_node.id, ui_node.ui.sine.input);
+                    project_.graph.insert_edge(ui_node.id, ui_node.ui.sine.input);
 
-                    nodes_.push_back(ui_node);
+                    project_.nodes.push_back(ui_node);
                     ImNodes::SetNodeScreenSpacePos(ui_node.id, click_pos);
                 }
 
@@ -520,9 +434,9 @@ public:
                 {
                     UiNode ui_node;
                     ui_node.type = UiNodeType::time;
-                    ui_node.id = graph_.insert_node(Node(NodeType::time));
+                    ui_node.id = project_.graph.insert_node(Node(NodeType::time));
 
-                    nodes_.push_back(ui_node);
+                    project_.nodes.push_back(ui_node);
                     ImNodes::SetNodeScreenSpacePos(ui_node.id, click_pos);
                 }
 
@@ -533,14 +447,14 @@ public:
 
                     UiNode ui_node;
                     ui_node.type = UiNodeType::power;
-                    ui_node.ui.power.lhs = graph_.insert_node(value);
-                    ui_node.ui.power.rhs = graph_.insert_node(value);
-                    ui_node.id = graph_.insert_node(op);
+                    ui_node.ui.power.lhs = project_.graph.insert_node(value);
+                    ui_node.ui.power.rhs = project_.graph.insert_node(value);
+                    ui_node.id = project_.graph.insert_node(op);
 
-                    graph_.insert_edge(ui_node.id, ui_node.ui.power.lhs);
-                    graph_.insert_edge(ui_node.id, ui_node.ui.power.rhs);
+                    project_.graph.insert_edge(ui_node.id, ui_node.ui.power.lhs);
+                    project_.graph.insert_edge(ui_node.id, ui_node.ui.power.rhs);
 
-                    nodes_.push_back(ui_node);
+                    project_.nodes.push_back(ui_node);
                     ImNodes::SetNodeScreenSpacePos(ui_node.id, click_pos);
                 }
 
@@ -551,10 +465,10 @@ public:
 
                     UiNode ui_node;
                     ui_node.type = UiNodeType::cubeviewport;
-                    ui_node.ui.cubeviewport.input = graph_.insert_node(value);
-                    ui_node.id = graph_.insert_node(op);
-                    graph_.insert_edge(ui_node.id, ui_node.ui.cubeviewport.input);
-                    nodes_.push_back(ui_node);
+                    ui_node.ui.cubeviewport.input = project_.graph.insert_node(value);
+                    ui_node.id = project_.graph.insert_node(op);
+                    project_.graph.insert_edge(ui_node.id, ui_node.ui.cubeviewport.input);
+                    project_.nodes.push_back(ui_node);
                     std::cout << "cube viewport node created with ID: " << ui_node.id << std::endl;
                     ImNodes::SetNodeScreenSpacePos(ui_node.id, click_pos);
                 }
@@ -567,346 +481,462 @@ public:
 
                     UiNode ui_node;
                     ui_node.type = UiNodeType::sphereviewport;
-                    ui_node.ui.cubeviewport.input = graph_.insert_node(value);
-                    ui_node.id = graph_.insert_node(op);
-                    graph_.insert_edge(ui_node.id, ui_node.ui.sphereviewport.input);
-                    nodes_.push_back(ui_node);
+                    ui_node.ui.cubeviewport.input = project_.graph.insert_node(value);
+                    ui_node.id = project_.graph.insert_node(op);
+                    project_.graph.insert_edge(ui_node.id, ui_node.ui.sphereviewport.input);
+                    project_.nodes.push_back(ui_node);
                     std::cout << "Sphere viewport node created with ID: " << ui_node.id << std::endl;
                     ImNodes::SetNodeScreenSpacePos(ui_node.id, click_pos);
                 }
 
+                if (ImGui::MenuItem("mesh viewport"))
+                {
+                    const Node value(NodeType::value, 0.f);
+                    const Node op(NodeType::meshviewport);
+
+                    UiNode ui_node;
+                    ui_node.type = UiNodeType::meshviewport;
+                    ui_node.ui.meshviewport.input = project_.graph.insert_node(value);
+                    ui_node.id = project_.graph.insert_node(op);
+                    project_.graph.insert_edge(ui_node.id, ui_node.ui.meshviewport.input);
+                    project_.nodes.push_back(ui_node);
+                    ImNodes::SetNodeScreenSpacePos(ui_node.id, click_pos);
+                }
+
+                if (ImGui::MenuItem("texture"))
+                {
+                    UiNode ui_node;
+                    ui_node.type = UiNodeType::texture;
+                    ui_node.id = project_.graph.insert_node(Node(NodeType::texture));
+                    project_.nodes.push_back(ui_node);
+                    ImNodes::SetNodeScreenSpacePos(ui_node.id, click_pos);
+                }
+
                 ImGui::EndPopup();
             }
             ImGui::PopStyleVar();
         }
 
-        for (const UiNode& node : nodes_)
+        // Paths typed into mesh viewports and texture nodes
+        std::vector<std::pair<int, std::string>> path_edits;
+
+        // Nodes outside the canvas are stood in for by empty items of their
+        // last layout, which is enough for selection, the minimap and links
+        const ImVec2 panning = ImNodes::EditorContextGetPanning();
+        const ImVec2 visible_min(-panning.x - cull_margin, -panning.y - cull_margin);
+        const ImVec2 visible_max(canvas_size.x - panning.x + cull_margin, canvas_size.y - panning.y + cull_margin);
+        nodes_submitted_ = 0;
+        nodes_culled_ = 0;
+
+        for (const UiNode& node : project_.nodes)
         {
+            auto layout = node_layouts_.find(node.id);
+            if (layout != node_layouts_.end() && !layout->second.overlaps(ImNodes::GetNodeGridSpacePos(node.id),
+                                                                          visible_min, visible_max))
+            {
+                show_culled_node(node, layout->second);
+                nodes_culled_ += 1;
+                continue;
+            }
+            nodes_submitted_ += 1;
+
             switch (node.type)
             {
             case UiNodeType::add:
             {
                 const float node_width = 100.f;
-                ImNodes::BeginNode(node.id);
+                begin_node(node.id);
 
                 ImNodes::BeginNodeTitleBar();
                 ImGui::TextUnformatted("add");
-                ImNodes::EndNodeTitleBar();
+                end_title_bar();
                 {
-                    ImNodes::BeginInputAttribute(node.ui.add.lhs);
+                    begin_input(node.ui.add.lhs);
                     const float label_width = ImGui::CalcTextSize("left").x;
                     ImGui::TextUnformatted("left");
-                    if (graph_.num_edges_from_node(node.ui.add.lhs) == 0ull)
+                    if (project_.graph.num_edges_from_node(node.ui.add.lhs) == 0ull)
                     {
                         ImGui::SameLine();
                         ImGui::PushItemWidth(node_width - label_width);
-                        ImGui::DragFloat("##hidelabel", &graph_.node(node.ui.add.lhs).value, 0.01f);
+                        ImGui::DragFloat("##hidelabel", &project_.graph.node(node.ui.add.lhs).value, 0.01f);
                         ImGui::PopItemWidth();
                     }
-                    ImNodes::EndInputAttribute();
+                    end_attribute();
                 }
 
                 {
-                    ImNodes::BeginInputAttribute(node.ui.add.rhs);
+                    begin_input(node.ui.add.rhs);
                     const float label_width = ImGui::CalcTextSize("right").x;
                     ImGui::TextUnformatted("right");
-                    if (graph_.num_edges_from_node(node.ui.add.rhs) == 0ull)
+                    if (project_.graph.num_edges_from_node(node.ui.add.rhs) == 0ull)
                     {
                         ImGui::SameLine();
                         ImGui::PushItemWidth(node_width - label_width);
-                        ImGui::DragFloat("##hidelabel", &graph_.node(node.ui.add.rhs).value, 0.01f);
+                        ImGui::DragFloat("##hidelabel", &project_.graph.node(node.ui.add.rhs).value, 0.01f);
                         ImGui::PopItemWidth();
                     }
-                    ImNodes::EndInputAttribute();
+                    end_attribute();
                 }
 
                 ImGui::Spacing();
 
                 {
-                    ImNodes::BeginOutputAttribute(node.id);
+                    begin_output(node.id);
                     const float label_width = ImGui::CalcTextSize("result").x;
                     ImGui::Indent(node_width - label_width);
                     ImGui::TextUnformatted("result");
-                    ImNodes::EndOutputAttribute();
+                    end_attribute();
                 }
 
-                ImNodes::EndNode();
+                end_node();
             }
             break;
             case UiNodeType::multiply:
             {
                 const float node_width = 100.0f;
-                ImNodes::BeginNode(node.id);
+                begin_node(node.id);
 
                 ImNodes::BeginNodeTitleBar();
                 ImGui::TextUnformatted("multiply");
-                ImNodes::EndNodeTitleBar();
+                end_title_bar();
 
                 {
-                    ImNodes::BeginInputAttribute(node.ui.multiply.lhs);
+                    begin_input(node.ui.multiply.lhs);
                     const float label_width = ImGui::CalcTextSize("left").x;
                     ImGui::TextUnformatted("left");
-                    if (graph_.num_edges_from_node(node.ui.multiply.lhs) == 0ull)
+                    if (project_.graph.num_edges_from_node(node.ui.multiply.lhs) == 0ull)
                     {
                         ImGui::SameLine();
                         ImGui::PushItemWidth(node_width - label_width);
                         ImGui::DragFloat(
-                            "##hidelabel", &graph_.node(node.ui.multiply.lhs).value, 0.01f);
+                            "##hidelabel", &project_.graph.node(node.ui.multiply.lhs).value, 0.01f);
                         ImGui::PopItemWidth();
                     }
-                    ImNodes::EndInputAttribute();
+                    end_attribute();
                 }
 
                 {
-                    ImNodes::BeginInputAttribute(node.ui.multiply.rhs);
+                    begin_input(node.ui.multiply.rhs);
                     const float label_width = ImGui::CalcTextSize("right").x;
                     ImGui::TextUnformatted("right");
-                    if (graph_.num_edges_from_node(node.ui.multiply.rhs) == 0ull)
+                    if (project_.graph.num_edges_from_node(node.ui.multiply.rhs) == 0ull)
                     {
                         ImGui::SameLine();
                         ImGui::PushItemWidth(node_width - label_width);
                         ImGui::DragFloat(
-                            "##hidelabel", &graph_.node(node.ui.multiply.rhs).value, 0.01f);
+                            "##hidelabel", &project_.graph.node(node.ui.multiply.rhs).value, 0.01f);
                         ImGui::PopItemWidth();
                     }
-                    ImNodes::EndInputAttribute();
+                    end_attribute();
                 }
 
                 ImGui::Spacing();
 
                 {
-                    ImNodes::BeginOutputAttribute(node.id);
+                    begin_output(node.id);
                     const float label_width = ImGui::CalcTextSize("result").x;
                     ImGui::Indent(node_width - label_width);
                     ImGui::TextUnformatted("result");
-                    ImNodes::EndOutputAttribute();
+                    end_attribute();
                 }
 
-                ImNodes::EndNode();
+                end_node();
             }
             break;
             case UiNodeType::output:
             {
                 const float node_width = 100.0f;
-                ImNodes::PushColorStyle(ImNodesCol_TitleBar, IM_COL32(11, 109, 191, 255));
-                ImNodes::PushColorStyle(ImNodesCol_TitleBarHovered, IM_COL32(45, 126, 194, 255));
-                ImNodes::PushColorStyle(ImNodesCol_TitleBarSelected, IM_COL32(81, 148, 204, 255));
-                ImNodes::BeginNode(node.id);
+                push_output_colors();
+                begin_node(node.id);
 
                 ImNodes::BeginNodeTitleBar();
                 ImGui::TextUnformatted("output");
-                ImNodes::EndNodeTitleBar();
+                end_title_bar();
 
                 ImGui::Dummy(ImVec2(node_width, 0.f));
                 {
-                    ImNodes::BeginInputAttribute(node.ui.output.r);
+                    begin_input(node.ui.output.r);
                     const float label_width = ImGui::CalcTextSize("r").x;
                     ImGui::TextUnformatted("r");
-                    if (graph_.num_edges_from_node(node.ui.output.r) == 0ull)
+                    if (project_.graph.num_edges_from_node(node.ui.output.r) == 0ull)
                     {
                         ImGui::SameLine();
                         ImGui::PushItemWidth(node_width - label_width);
                         ImGui::DragFloat(
-                            "##hidelabel", &graph_.node(node.ui.output.r).value, 0.01f, 0.f, 1.0f);
+                            "##hidelabel", &project_.graph.node(node.ui.output.r).value, 0.01f, 0.f, 1.0f);
                         ImGui::PopItemWidth();
                     }
-                    ImNodes::EndInputAttribute();
+                    end_attribute();
                 }
 
                 ImGui::Spacing();
 
                 {
-                    ImNodes::BeginInputAttribute(node.ui.output.g);
+                    begin_input(node.ui.output.g);
                     const float label_width = ImGui::CalcTextSize("g").x;
                     ImGui::TextUnformatted("g");
-                    if (graph_.num_edges_from_node(node.ui.output.g) == 0ull)
+                    if (project_.graph.num_edges_from_node(node.ui.output.g) == 0ull)
                     {
                         ImGui::SameLine();
                         ImGui::PushItemWidth(node_width - label_width);
                         ImGui::DragFloat(
-                            "##hidelabel", &graph_.node(node.ui.output.g).value, 0.01f, 0.f, 1.f);
+                            "##hidelabel", &project_.graph.node(node.ui.output.g).value, 0.01f, 0.f, 1.f);
                         ImGui::PopItemWidth();
                     }
-                    ImNodes::EndInputAttribute();
+                    end_attribute();
                 }
 
                 ImGui::Spacing();
 
                 {
-                    ImNodes::BeginInputAttribute(node.ui.output.b);
+                    begin_input(node.ui.output.b);
                     const float label_width = ImGui::CalcTextSize("b").x;
                     ImGui::TextUnformatted("b");
-                    if (graph_.num_edges_from_node(node.ui.output.b) == 0ull)
+                    if (project_.graph.num_edges_from_node(node.ui.output.b) == 0ull)
                     {
                         ImGui::SameLine();
                         ImGui::PushItemWidth(node_width - label_width);
                         ImGui::DragFloat(
-                            "##hidelabel", &graph_.node(node.ui.output.b).value, 0.01f, 0.f, 1.0f);
+                            "##hidelabel", &project_.graph.node(node.ui.output.b).value, 0.01f, 0.f, 1.0f);
                         ImGui::PopItemWidth();
                     }
-                    ImNodes::EndInputAttribute();
+                    end_attribute();
                 }
-                ImNodes::EndNode();
-                ImNodes::PopColorStyle();
-                ImNodes::PopColorStyle();
-                ImNodes::PopColorStyle();
+                end_node();
+                pop_output_colors();
             }
             break;
             case UiNodeType::sine:
             {
                 const float node_width = 100.0f;
-                ImNodes::BeginNode(node.id);
+                begin_node(node.id);
 
                 ImNodes::BeginNodeTitleBar();
                 ImGui::TextUnformatted("sine");
-                ImNodes::EndNodeTitleBar();
+                end_title_bar();
 
                 {
-                    ImNodes::BeginInputAttribute(node.ui.sine.input);
+                    begin_input(node.ui.sine.input);
                     const float label_width = ImGui::CalcTextSize("number").x;
                     ImGui::TextUnformatted("number");
-                    if (graph_.num_edges_from_node(node.ui.sine.input) == 0ull)
+                    if (project_.graph.num_edges_from_node(node.ui.sine.input) == 0ull)
                     {
                         ImGui::SameLine();
                         ImGui::PushItemWidth(node_width - label_width);
                         ImGui::DragFloat(
                             "##hidelabel",
-                            &graph_.node(node.ui.sine.input).value,
+                            &project_.graph.node(node.ui.sine.input).value,
                             0.01f,
                             0.f,
                             1.0f);
                         ImGui::PopItemWidth();
                     }
-                    ImNodes::EndInputAttribute();
+                    end_attribute();
                 }
 
                 ImGui::Spacing();
 
                 {
-                    ImNodes::BeginOutputAttribute(node.id);
+                    begin_output(node.id);
                     const float label_width = ImGui::CalcTextSize("output").x;
                     ImGui::Indent(node_width - label_width);
                     ImGui::TextUnformatted("output");
-                    ImNodes::EndOutputAttribute();
+                    end_attribute();
                 }
 
-                ImNodes::EndNode();
+                end_node();
             }
             break;
             case UiNodeType::time:
             {
-                ImNodes::BeginNode(node.id);
+                begin_node(node.id);
 
                 ImNodes::BeginNodeTitleBar();
                 ImGui::TextUnformatted("time");
-                ImNodes::EndNodeTitleBar();
+                end_title_bar();
 
-                ImNodes::BeginOutputAttribute(node.id);
+                begin_output(node.id);
                 ImGui::Text("output");
-                ImNodes::EndOutputAttribute();
+                end_attribute();
 
-                ImNodes::EndNode();
+                end_node();
             }
             break;
             case UiNodeType::power:
             {
                 //const float node_width = 100.f;
-                ImNodes::BeginNode(node.id);
+                begin_node(node.id);
 
                 ImNodes::BeginNodeTitleBar();
                 ImGui::TextUnformatted("Power");
-                ImNodes::EndNodeTitleBar();
+                end_title_bar();
 
-                ImNodes::BeginInputAttribute(node.ui.power.lhs);
+                begin_input(node.ui.power.lhs);
                 ImGui::TextUnformatted("Base");
-                ImNodes::EndInputAttribute();
+                end_attribute();
 
-                ImNodes::BeginInputAttribute(node.ui.power.rhs);
+                begin_input(node.ui.power.rhs);
                 ImGui::TextUnformatted("Exponent");
-                ImNodes::EndInputAttribute();
+                end_attribute();
 
-                ImNodes::BeginOutputAttribute(node.id);
+                begin_output(node.id);
                 ImGui::TextUnformatted("Result");
-                ImNodes::EndOutputAttribute();
+                end_attribute();
 
-                ImNodes::EndNode();
+                end_node();
             }
             break;
             case UiNodeType::cubeviewport:
             {
-                ImNodes::BeginNode(node.id);
+                begin_node(node.id);
 
                 ImNodes::BeginNodeTitleBar();
                 ImGui::TextUnformatted("Cube Viewport");
-                ImNodes::EndNodeTitleBar();
+                end_title_bar();
 
-                ImNodes::BeginInputAttribute(node.ui.cubeviewport.input);
+                begin_input(node.ui.cubeviewport.input);
                 ImGui::TextUnformatted("Input");
-                ImNodes::EndInputAttribute();
+                end_attribute();
 
-                glm::vec3 color(1.0f, 1.0f, 1.0f);
-                if (graph_.num_edges_from_node(node.ui.cubeviewport.input) > 0)
-                {
-                    int input_id = graph_.node(node.ui.cubeviewport.input).value;
-                    color.r = clamp(graph_.node(input_id).value, 0.0f, 1.0f);
-                    color.g = clamp(graph_.node(input_id + 1).value, 0.0f, 1.0f);
-                    color.b = clamp(graph_.node(input_id + 2).value, 0.0f, 1.0f);
-                }
+                const glm::vec3 color = evaluate_viewport(node);
 
-                frameBuffer.Bind();
-                render_to_framebuffer_cube(color);
-                //frameBuffer.RescaleFrameBuffer(50,50);
-                ImGui::Image((ImTextureID)frameBuffer.getFrameTexture(), ImVec2(200, 200));
-                frameBuffer.Unbind();
-                ImNodes::EndNode();
+                viewColor_ = color;
+                show_node_preview(node.id, thumbnails_.cube_key(color, rotationX, rotationY, preview_pixels_),
+                                  ImVec2(200, 200));
+                end_node();
             }
             break;
             case UiNodeType::sphereviewport:
             {
-                ImNodes::BeginNode(node.id);
+                begin_node(node.id);
 
                 ImNodes::BeginNodeTitleBar();
                 ImGui::TextUnformatted("Sphere Viewport");
-                ImNodes::EndNodeTitleBar();
+                end_title_bar();
 
-                ImNodes::BeginInputAttribute(node.ui.sphereviewport.input);
+                begin_input(node.ui.sphereviewport.input);
                 ImGui::TextUnformatted("Input");
-                ImNodes::EndInputAttribute();
+                end_attribute();
+
+                const glm::vec3 color = evaluate_viewport(node);
+
+                show_node_preview(node.id, thumbnails_.sphere_key(color, preview_pixels_), ImVec2(200, 200));
+                end_node();
+            }
+            break;
+            case UiNodeType::meshviewport:
+            {
+                begin_node(node.id);
+
+                ImNodes::BeginNodeTitleBar();
+                ImGui::TextUnformatted("Mesh Viewport");
+                end_title_bar();
+
+                begin_input(node.ui.meshviewport.input);
+                ImGui::TextUnformatted("Input");
+                end_attribute();
+
+                edit_path(node, path_edits);
+
+                const MeshLibrary::Entry& mesh = meshes_.request(node.path);
+                if (mesh.state == MeshState::loading)
+                {
+                    ImGui::TextUnformatted("Loading...");
+                }
+                else if (mesh.state == MeshState::failed)
+                {
+                    ImGui::TextUnformatted(node.path.empty() ? "Enter an OBJ file" : "Cannot load the file");
+                }
+                else
+                {
+                    ImGui::Text("%zu triangles", mesh.triangles);
+                }
+
+                const glm::vec3 color = evaluate_viewport(node);
+
+                show_node_preview(node.id,
+                                  thumbnails_.mesh_key(color, rotationX, rotationY, mesh.handle, mesh.fit,
+                                                       preview_pixels_),
+                                  ImVec2(200, 200));
+                end_node();
+            }
+            break;
+            case UiNodeType::texture:
+            {
+                begin_node(node.id);
 
-                glm::vec3 color(1.0f, 1.0f, 1.0f);
-                if (graph_.num_edges_from_node(node.ui.sphereviewport.input) > 0)
+                ImNodes::BeginNodeTitleBar();
+                ImGui::TextUnformatted("Texture");
+                end_title_bar();
+
+                edit_path(node, path_edits);
+
+                // Only textures on screen count as used for the memory budget
+                const TextureLibrary::Entry& texture =
+                    textures_.request(node.path, ImGui::IsRectVisible(ImVec2(200.f, 200.f)));
+                if (texture.state == TextureState::ready)
+                {
+                    const float scale = 200.f / std::max(texture.width, texture.height);
+                    ImGui::Image((ImTextureID)(intptr_t)texture.texture,
+                                 ImVec2(texture.width * scale, texture.height * scale));
+                    ImGui::Text("%d x %d", texture.width, texture.height);
+                }
+                else
                 {
-                    int input_id = graph_.node(node.ui.sphereviewport.input).value;
-                    color.r = clamp(graph_.node(input_id).value, 0.0f, 1.0f);
-                    color.g = clamp(graph_.node(input_id + 1).value, 0.0f, 1.0f);
-                    color.b = clamp(graph_.node(input_id + 2).value, 0.0f, 1.0f);
+                    ImGui::TextUnformatted(texture.state == TextureState::loading ? "Loading..."
+                                           : node.path.empty()                   ? "Enter an image file"
+                                                                                 : "Cannot load the file");
                 }
 
-                frameBUfferSphere.Bind();
-                render_to_framebuffer_sphere(color);
-                ImGui::Image((ImTextureID)frameBUfferSphere.getFrameTexture(), ImVec2(200, 200));
-                frameBUfferSphere.Unbind();
-                ImNodes::EndNode();
+                begin_output(node.id);
+                ImGui::TextUnformatted("brightness");
+                end_attribute();
+
+                end_node();
             }
             break;
             }
 
         }
 
-        for (const auto& edge : graph_.edges())
+        for (const auto& edge : project_.graph.edges())
         {
             // If edge doesn't start at value, then it's an internal edge, i.e.
             // an edge which links a node's operation to its input. We don't
             // want to render node internals with visible links.
-            if (graph_.node(edge.from).type != NodeType::value)
+            if (project_.graph.node(edge.from).type != NodeType::value)
                 continue;
 
             ImNodes::Link(edge.id, edge.from, edge.to);
         }
 
+        for (const auto& [node_id, path] : path_edits)
+        {
+            const int id = node_id;
+            auto iter = std::find_if(project_.nodes.begin(), project_.nodes.end(), [id](const UiNode& node) {
+                return node.id == id;
+            });
+            if (iter != project_.nodes.end())
+            {
+                iter->path = path;
+                if (iter->type == UiNodeType::texture)
+                {
+                    texture_means_pending_.push_back(id);
+                }
+            }
+        }
+
         ImNodes::MiniMap(0.2f, minimap_location_);
         ImNodes::EndNodeEditor();
 
+        // All previews requested by the viewport nodes in a few draw calls
+        const RenderResource atlas = render_graph_.import("thumbnail atlas");
+        render_graph_.add_pass("thumbnails", {}, {atlas}, [this] { thumbnails_.flush(); });
+        if (thumbnails_.has_pending())
+        {
+            render_graph_.present(atlas);
+        }
+
         // Handle new links
         // These are driven by Imnodes, so we place the code after EndNodeEditor().
 
@@ -914,8 +944,8 @@ public:
             int start_attr, end_attr;
             if (ImNodes::IsLinkCreated(&start_attr, &end_attr))
             {
-                const NodeType start_type = graph_.node(start_attr).type;
-                const NodeType end_type = graph_.node(end_attr).type;
+                const NodeType start_type = project_.graph.node(start_attr).type;
+                const NodeType end_type = project_.graph.node(end_attr).type;
 
                 const bool valid_link = start_type != end_type;
                 if (valid_link)
@@ -926,7 +956,7 @@ public:
                     {
                         std::swap(start_attr, end_attr);
                     }
-                    graph_.insert_edge(start_attr, end_attr);
+                    project_.graph.insert_edge(start_attr, end_attr);
                 }
             }
         }
@@ -937,7 +967,7 @@ public:
             int link_id;
             if (ImNodes::IsLinkDestroyed(&link_id))
             {
-                graph_.erase_edge(link_id);
+                project_.graph.erase_edge(link_id);
             }
         }
 
@@ -950,7 +980,7 @@ public:
                 ImNodes::GetSelectedLinks(selected_links.data());
                 for (const int edge_id : selected_links)
                 {
-                    graph_.erase_edge(edge_id);
+                    project_.graph.erase_edge(edge_id);
                 }
             }
         }
@@ -964,42 +994,50 @@ public:
                 ImNodes::GetSelectedNodes(selected_nodes.data());
                 for (const int node_id : selected_nodes)
                 {
-                    graph_.erase_node(node_id);
+                    project_.graph.erase_node(node_id);
                     auto iter = std::find_if(
-                        nodes_.begin(), nodes_.end(), [node_id](const UiNode& node) -> bool {
+                        project_.nodes.begin(), project_.nodes.end(), [node_id](const UiNode& node) -> bool {
                             return node.id == node_id;
                         });
                     // Erase any additional internal nodes
                     switch (iter->type)
                     {
                     case UiNodeType::add:
-                        graph_.erase_node(iter->ui.add.lhs);
-                        graph_.erase_node(iter->ui.add.rhs);
+                        project_.graph.erase_node(iter->ui.add.lhs);
+                        project_.graph.erase_node(iter->ui.add.rhs);
                         break;
                     case UiNodeType::multiply:
-                        graph_.erase_node(iter->ui.multiply.lhs);
-                        graph_.erase_node(iter->ui.multiply.rhs);
+                        project_.graph.erase_node(iter->ui.multiply.lhs);
+                        project_.graph.erase_node(iter->ui.multiply.rhs);
                         break;
                     case UiNodeType::output:
-                        graph_.erase_node(iter->ui.output.r);
-                        graph_.erase_node(iter->ui.output.g);
-                        graph_.erase_node(iter->ui.output.b);
-                        root_node_id_ = -1;
+                        project_.graph.erase_node(iter->ui.output.r);
+                        project_.graph.erase_node(iter->ui.output.g);
+                        project_.graph.erase_node(iter->ui.output.b);
+                        project_.root_node_id = -1;
                         break;
                     case UiNodeType::sine:
-                        graph_.erase_node(iter->ui.sine.input);
+                        project_.graph.erase_node(iter->ui.sine.input);
                         break;
                     case UiNodeType::power:
-                        graph_.erase_node(iter->ui.power.lhs);
-                        graph_.erase_node(iter->ui.power.rhs);
+                        project_.graph.erase_node(iter->ui.power.lhs);
+                        project_.graph.erase_node(iter->ui.power.rhs);
+                        break;
+                    case UiNodeType::cubeviewport:
+                        project_.graph.erase_node(iter->ui.cubeviewport.input);
+                        break;
+                    case UiNodeType::sphereviewport:
+                        project_.graph.erase_node(iter->ui.sphereviewport.input);
+                        break;
+                    case UiNodeType::meshviewport:
+                        project_.graph.erase_node(iter->ui.meshviewport.input);
                         break;
-                    //case UiNodeType::viewport:
-                    //    graph_.erase_node(iter->ui.viewport.input);
-                    //    break;
                     default:
                         break;
                     }
-                    nodes_.erase(iter);
+                    thumbnails_.release(node_id);
+                    node_layouts_.erase(node_id);
+                    project_.nodes.erase(iter);
                 }
             }
         }
@@ -1008,170 +1046,393 @@ public:
 
         // The color output window
 
-        const ImU32 color =
-            root_node_id_ != -1 ? evaluate(graph_, root_node_id_) : IM_COL32(255, 20, 147, 255);
+        const ImU32 color = project_.root_node_id != -1
+                                ? evaluate(project_.graph, project_.root_node_id)
+                                : IM_COL32(255, 20, 147, 255);
         ImGui::PushStyleColor(ImGuiCol_WindowBg, color);
         ImGui::Begin("output color");
         ImGui::End();
         ImGui::PopStyleColor();
 
-        ImGui::Begin("3d view");
-        ImVec2 windowSize = ImGui::GetContentRegionAvail();
-        ImGui::Image(ImTextureID(frameBuffer.getFrameTexture()), windowSize);
+        // Not drawn while the window is collapsed or hidden behind a tab, nor
+        // when nothing in it changed
+        const RenderResource view = render_graph_.import("3d view");
+        PreviewKey viewKey;
+        if (ImGui::Begin("3d view"))
+        {
+            ImVec2 windowSize = ImGui::GetContentRegionAvail();
+            // Drawn at the pixel size of the window, scaled down like the node
+            // previews when frames are over budget, into the lower left of a
+            // target that is only reallocated when the size changes a lot
+            const ImVec2 pixelScale = ImGui::GetIO().DisplayFramebufferScale;
+            const int viewWidth = std::max(1, static_cast<int>(windowSize.x * pixelScale.x * resolution_.scale()));
+            const int viewHeight = std::max(1, static_cast<int>(windowSize.y * pixelScale.y * resolution_.scale()));
+            if (frameBuffer.ResizeToFit(viewWidth, viewHeight))
+            {
+                frameBufferKey_ = PreviewKey();
+            }
+            viewKey = preview_.cube_key(viewColor_, rotationX, rotationY, viewWidth, viewHeight);
+            if (viewKey != frameBufferKey_)
+            {
+                render_graph_.present(view);
+            }
+            ImGui::Image(ImTextureID(frameBuffer.getFrameTexture()), windowSize, ImVec2(0.f, 0.f),
+                         ImVec2(float(viewWidth) / frameBuffer.GetWidth(), float(viewHeight) / frameBuffer.GetHeigth()));
+        }
         ImGui::End();
+        render_graph_.add_pass("3d view", {}, {view},
+                               [this, viewKey] { preview_.render_if_changed(frameBuffer, frameBufferKey_, viewKey); });
+
+        // The passes draw before main() renders the ImGui draw lists
+        render_graph_.execute(&gpu_timer_);
+
+        show_statistics();
+        show_gpu_times();
+        was_idle_ = is_idle();
     }
 
+    GpuTimer& gpu_timer() { return gpu_timer_; }
 
-    ImU32 evaluate(const Graph<Node>& graph, const int root_node)
+    // Whether the next frame would look like the last one unless there is
+    // input: nothing shown depends on the time and no file, program or
+    // preview is still on its way
+    bool is_idle() const
     {
-        std::stack<int> postorder;
-        dfs_traverse(
-            graph, root_node, [&postorder](const int node_id) -> void { postorder.push(node_id); });
+        return !animating_ && !meshes_.busy() && !textures_.busy() && !preview_.compiling() &&
+               !thumbnails_.has_pending() && resolution_.scale() >= 1.f;
+    }
 
-        std::stack<float> value_stack;
-        while (!postorder.empty())
+    void show_statistics()
+    {
+        const MeshStats& meshes = preview_.mesh_stats();
+        // Buffers created since the previous frame, 0 unless a mesh was added
+        const uint64_t created_this_frame = meshes.buffers_created - last_buffers_created_;
+        last_buffers_created_ = meshes.buffers_created;
+        const uint64_t renders_this_frame = preview_.renders() - last_preview_renders_;
+        last_preview_renders_ = preview_.renders();
+
+        if (!show_statistics_)
         {
-            const int id = postorder.top();
-            postorder.pop();
-            const Node node = graph.node(id);
+            return;
+        }
 
-            switch (node.type)
-            {
-            case NodeType::add:
-            {
-                const float rhs = value_stack.top();
-                value_stack.pop();
-                const float lhs = value_stack.top();
-                value_stack.pop();
-                value_stack.push(lhs + rhs);
-            }
-            break;
-            case NodeType::multiply:
-            {
-                const float rhs = value_stack.top();
-                value_stack.pop();
-                const float lhs = value_stack.top();
-                value_stack.pop();
-                value_stack.push(rhs * lhs);
-            }
-            break;
-            case NodeType::sine:
-            {
-                const float x = value_stack.top();
-                value_stack.pop();
-                const float res = std::abs(std::sin(x));
-                value_stack.push(res);
-            }
-            break;
-            case NodeType::time:
-            {
-                value_stack.push(current_time_seconds);
-            }
-            break;
-            case NodeType::value:
+        ImGui::Begin("statistics", &show_statistics_);
+        ImGui::Text("Meshes: %zu", meshes.live_meshes);
+        ImGui::Text("Vertex arrays: %zu", meshes.live_vertex_arrays);
+        ImGui::Text("Buffers: %zu", meshes.live_buffers);
+        ImGui::Text("Mesh memory: %.1f KiB", meshes.gpu_bytes / 1024.0);
+        ImGui::Text("Buffers created / deleted: %llu / %llu", (unsigned long long)meshes.buffers_created,
+                    (unsigned long long)meshes.buffers_deleted);
+        ImGui::Text("Buffers created this frame: %llu", (unsigned long long)created_this_frame);
+        ImGui::Text("Frame uniform uploads: %llu", (unsigned long long)preview_.frame_uploads());
+        ImGui::Text("Previews drawn this frame: %llu", (unsigned long long)renders_this_frame);
+        const ThumbnailStats& thumbnails = thumbnails_.stats();
+        ImGui::Text("Thumbnails drawn this frame: %zu in %zu draw calls", thumbnails.thumbnails_drawn,
+                    thumbnails.draw_calls);
+        ImGui::Text("Thumbnail cells: %zu on %zu pages", thumbnails.slots_in_use, thumbnails.pages);
+        const ProgramCacheStats& programs = ProgramBinaryCache::instance().stats();
+        ImGui::Text("Programs from cache: %llu (%.1f ms), compiled: %llu (%.1f ms)", (unsigned long long)programs.hits,
+                    programs.hit_milliseconds, (unsigned long long)programs.misses, programs.miss_milliseconds);
+        const MeshLibraryStats& files = meshes_.stats();
+        ImGui::Text("Mesh files: %zu (%zu loading), %zu triangles", files.meshes, files.loading, files.triangles);
+        ImGui::Text("Mesh loads from cache / OBJ: %llu / %llu (%.1f ms)", (unsigned long long)files.loads_from_cache,
+                    (unsigned long long)files.loads_from_obj, files.load_milliseconds);
+        const TextureLibraryStats& images = textures_.stats();
+        ImGui::Text("Textures: %zu (%zu loading, %zu evicted)", images.textures, images.loading, images.evicted);
+        ImGui::Text("Texture memory: %.1f / %.1f MiB", images.gpu_bytes / (1024.0 * 1024.0),
+                    images.budget_bytes / (1024.0 * 1024.0));
+        const uint64_t texture_requests = images.hits + images.misses;
+        ImGui::Text("Texture hits / misses: %llu / %llu (%.1f %% hits), evictions: %llu",
+                    (unsigned long long)images.hits, (unsigned long long)images.misses,
+                    texture_requests > 0 ? 100.0 * images.hits / texture_requests : 100.0,
+                    (unsigned long long)images.evictions);
+        ImGui::Text("Texture decode / upload: %.1f / %.1f ms", images.decode_milliseconds, images.upload_milliseconds);
+        int budget_megabytes = static_cast<int>(textures_.budget() >> 20);
+        if (ImGui::DragInt("Texture budget (MiB)", &budget_megabytes, 1.f, 16, 16384))
+        {
+            textures_.set_budget(static_cast<size_t>(std::max(budget_megabytes, 16)) << 20);
+        }
+        ImGui::Text("Preview resolution: %.0f %% (%d px), frame %.1f ms", 100.f * resolution_.scale(),
+                    preview_pixels_, resolution_.average_milliseconds());
+        float frame_budget = resolution_.budget();
+        if (ImGui::DragFloat("Frame budget (ms)", &frame_budget, 0.1f, 1.f, 1000.f, "%.1f"))
+        {
+            resolution_.set_budget(frame_budget);
+        }
+        ImGui::Text("3d view target: %dx%d, %llu reallocations", frameBuffer.GetWidth(), frameBuffer.GetHeigth(),
+                    (unsigned long long)frameBuffer.GetReallocations());
+        const GlStateStats& gl_state = GlState::instance().stats();
+        ImGui::Text("GL state calls issued / avoided: %llu / %llu", (unsigned long long)gl_state.issued,
+                    (unsigned long long)gl_state.avoided);
+        ImGui::Text("Nodes drawn / culled: %zu / %zu", nodes_submitted_, nodes_culled_);
+        const RenderGraphStats& graph = render_graph_.stats();
+        ImGui::Text("Render passes run / culled: %zu / %zu, transients: %zu in %zu targets (%.1f of %.1f MiB)",
+                    graph.passes, graph.culled, graph.transients, graph.targets, graph.bytes / (1024.0 * 1024.0),
+                    graph.unaliased_bytes / (1024.0 * 1024.0));
+        const RenderTargetStats& targets = targets_.stats();
+        ImGui::Text("Preview targets: %zu (%zu in use)", targets.targets, targets.targets_in_use);
+        ImGui::Text("Preview target memory: %.1f MiB", targets.gpu_bytes / (1024.0 * 1024.0));
+        ImGui::Text("Target allocations / reuses: %llu / %llu", (unsigned long long)targets.allocations,
+                    (unsigned long long)targets.reuses);
+        ImGui::End();
+    }
+
+
+    void show_gpu_times()
+    {
+        if (!show_gpu_times_)
+        {
+            return;
+        }
+
+        ImGui::Begin("GPU times", &show_gpu_times_);
+        if (!gpu_timer_.supported())
+        {
+            ImGui::TextUnformatted("Timer queries are not supported by this driver.");
+            ImGui::End();
+            return;
+        }
+
+        double total = 0.0;
+        for (const GpuPassTime& pass : gpu_timer_.passes())
+        {
+            ImGui::Text("%s: %.3f ms (average %.3f, max %.3f)", pass.name.c_str(), pass.last, pass.average,
+                        pass.max);
+            total += pass.average;
+        }
+        ImGui::Text("Total: %.3f ms average", total);
+        ImGui::Text("Results dropped late / invalid: %llu / %llu", (unsigned long long)gpu_timer_.dropped(),
+                    (unsigned long long)gpu_timer_.invalid());
+        if (ImGui::Button("Export CSV") && gpu_timer_.export_csv("gpu-times.csv"))
+        {
+            std::cout << "GPU times exported to: gpu-times.csv" << std::endl;
+        }
+        ImGui::End();
+    }
+
+    // The output of a texture node is the brightness of the whole image. It is
+    // stored in the node, and saved with it, once the image of a newly set
+    // path is decoded, so headless evaluation sees the same value.
+    void update_texture_means()
+    {
+        auto pending = texture_means_pending_.begin();
+        while (pending != texture_means_pending_.end())
+        {
+            const int id = *pending;
+            auto iter = std::find_if(project_.nodes.begin(), project_.nodes.end(),
+                                     [id](const UiNode& node) { return node.id == id; });
+            if (iter == project_.nodes.end())
             {
-                // If the edge does not have an edge connecting to another node, then just use the value
-                // at this node. It means the node's input pin has not been connected to anything and
-                // the value comes from the node's UI.
-                if (graph.num_edges_from_node(id) == 0ull)
-                {
-                    value_stack.push(node.value);
-                }
+                pending = texture_means_pending_.erase(pending);
+                continue;
             }
-            break;
-            case NodeType::power:
+
+            const TextureLibrary::Entry& texture = textures_.request(iter->path, false);
+            if (texture.state == TextureState::loading)
             {
-                const float rhs = value_stack.top();
-                value_stack.pop();
-                const float lhs = value_stack.top();
-                value_stack.pop();
-                value_stack.push(std::pow(lhs, rhs));
+                ++pending;
+                continue;
             }
+            project_.graph.node(id).value = texture.state == TextureState::ready ? texture.mean : 0.f;
+            pending = texture_means_pending_.erase(pending);
+        }
+    }
 
-            break;
-            default:
-                break;
-            }
+    // The file path field of mesh viewports and texture nodes. Enter queues
+    // the typed path, it is applied once all nodes are drawn.
+    void edit_path(const UiNode& node, std::vector<std::pair<int, std::string>>& path_edits)
+    {
+        char path[256];
+        std::snprintf(path, sizeof(path), "%s", node.path.c_str());
+        ImGui::PushItemWidth(200.f);
+        if (ImGui::InputText("##path", path, sizeof(path), ImGuiInputTextFlags_EnterReturnsTrue))
+        {
+            path_edits.emplace_back(node.id, path);
         }
+        ImGui::PopItemWidth();
+    }
 
-        // The final output node isn't evaluated in the loop -- instead we just pop
-        // the three values which should be in the stack.
-        assert(value_stack.size() == 3ull);
-        const int b = static_cast<int>(255.f * clamp(value_stack.top(), 0.f, 1.f) + 0.5f);
-        value_stack.pop();
-        const int g = static_cast<int>(255.f * clamp(value_stack.top(), 0.f, 1.f) + 0.5f);
-        value_stack.pop();
-        const int r = static_cast<int>(255.f * clamp(value_stack.top(), 0.f, 1.f) + 0.5f);
-        value_stack.pop();
+    // Submits a node in full, recording its layout for when it is culled
+    void begin_node(const int id)
+    {
+        ImNodes::BeginNode(id);
+        layout_node_ = id;
+        layout_ = &node_layouts_[id];
+        layout_->pins.clear();
+        layout_origin_ = ImGui::GetCursorScreenPos();
+    }
 
-        return IM_COL32(r, g, b, 255);
+    // The title bars hold a single text item
+    void end_title_bar()
+    {
+        layout_->title = ImGui::GetItemRectSize();
+        ImNodes::EndNodeTitleBar();
     }
 
+    void begin_input(const int id)
+    {
+        ImNodes::BeginInputAttribute(id);
+        layout_->pins.push_back({id, false, ImVec2(), ImVec2()});
+    }
 
-private:
-    enum class UiNodeType
+    void begin_output(const int id)
     {
-        add,
-        multiply,
-        output,
-        sine,
-        time,
-        power,
-        cubeviewport,
-        sphereviewport
-    };
+        ImNodes::BeginOutputAttribute(id);
+        layout_->pins.push_back({id, true, ImVec2(), ImVec2()});
+    }
+
+    void end_attribute()
+    {
+        PinLayout& pin = layout_->pins.back();
+        if (pin.output)
+        {
+            ImNodes::EndOutputAttribute();
+        }
+        else
+        {
+            ImNodes::EndInputAttribute();
+        }
+        const ImVec2 min = ImGui::GetItemRectMin();
+        pin.offset = ImVec2(min.x - layout_origin_.x, min.y - layout_origin_.y);
+        pin.size = ImGui::GetItemRectSize();
+    }
 
-    struct UiNode
+    void end_node()
     {
-        UiNodeType type;
-        // The identifying id of the ui node. For add, multiply, sine, and time
-        // this is the "operation" node id. The additional input nodes are
-        // stored in the structs.
-        int id;
+        ImNodes::EndNode();
+        // The node's group starts at the top left of its content
+        layout_->content = ImGui::GetItemRectSize();
+        layout_->size = ImNodes::GetNodeDimensions(layout_node_);
+        layout_ = nullptr;
+    }
 
-        union
+    // Empty items where the title bar, the content and the attributes of the
+    // node were last drawn, so it keeps its size and its pins their place
+    void show_culled_node(const UiNode& node, const NodeLayout& layout)
+    {
+        // What the node feeds outside the node editor
+        if (node.type == UiNodeType::cubeviewport)
         {
-            struct
-            {
-                int lhs, rhs;
-            } add;
+            viewColor_ = evaluate_viewport(node);
+        }
 
-            struct
+        if (node.type == UiNodeType::output)
+        {
+            push_output_colors();
+        }
+        ImNodes::BeginNode(node.id);
+        const ImVec2 origin = ImGui::GetCursorScreenPos();
+
+        ImNodes::BeginNodeTitleBar();
+        ImGui::Dummy(layout.title);
+        ImNodes::EndNodeTitleBar();
+        ImGui::SetCursorScreenPos(origin);
+        ImGui::Dummy(layout.content);
+        for (const PinLayout& pin : layout.pins)
+        {
+            // The attribute group starts at the cursor, not at its first item
+            ImGui::SetCursorScreenPos(ImVec2(origin.x + pin.offset.x, origin.y + pin.offset.y));
+            if (pin.output)
             {
-                int lhs, rhs;
-            } multiply;
-
-            struct
+                ImNodes::BeginOutputAttribute(pin.id);
+                ImGui::Dummy(pin.size);
+                ImNodes::EndOutputAttribute();
+            }
+            else
             {
-                int lhs, rhs;
-            } power;
+                ImNodes::BeginInputAttribute(pin.id);
+                ImGui::Dummy(pin.size);
+                ImNodes::EndInputAttribute();
+            }
+        }
+        ImNodes::EndNode();
+        if (node.type == UiNodeType::output)
+        {
+            pop_output_colors();
+        }
+    }
 
-            struct
-            {
-                int r, g, b;
-            } output;
+    static void push_output_colors()
+    {
+        ImNodes::PushColorStyle(ImNodesCol_TitleBar, IM_COL32(11, 109, 191, 255));
+        ImNodes::PushColorStyle(ImNodesCol_TitleBarHovered, IM_COL32(45, 126, 194, 255));
+        ImNodes::PushColorStyle(ImNodesCol_TitleBarSelected, IM_COL32(81, 148, 204, 255));
+    }
 
-            struct
-            {
-                int input;
-            } sine;
+    static void pop_output_colors()
+    {
+        ImNodes::PopColorStyle();
+        ImNodes::PopColorStyle();
+        ImNodes::PopColorStyle();
+    }
 
-            struct
-            {
-                int input;
-            } cubeviewport;
+    // Shows the atlas cell of a viewport node. The cell is drawn by the
+    // thumbnail flush after the node editor if key changed.
+    void show_node_preview(const int node_id, const PreviewKey& key, const ImVec2& size)
+    {
+        const ThumbnailAtlas::Region region = thumbnails_.request(node_id, key);
+        ImGui::Image((ImTextureID)(intptr_t)region.texture, size, ImVec2(region.uv0.x, region.uv0.y),
+                     ImVec2(region.uv1.x, region.uv1.y));
+    }
 
-            struct
-            {
-                int input;
-            } sphereviewport;
+    ImU32 evaluate(const Graph<Node>& graph, const int root_node)
+    {
+        EvalProgram program;
+        if (!program.compile(graph, root_node))
+        {
+            return IM_COL32(255, 20, 147, 255);
+        }
+        animating_ = animating_ || program.is_time_dependent();
+
+        const Rgb color = program.color(current_time_seconds, {0.f, 0.f, 0.f});
+        const int r = static_cast<int>(255.f * clamp(color.r, 0.f, 1.f) + 0.5f);
+        const int g = static_cast<int>(255.f * clamp(color.g, 0.f, 1.f) + 0.5f);
+        const int b = static_cast<int>(255.f * clamp(color.b, 0.f, 1.f) + 0.5f);
+
+        return IM_COL32(r, g, b, 255);
+    }
+
+    glm::vec3 evaluate_viewport(const UiNode& node)
+    {
+        Sink sink;
+        if (!compile_sink(project_, node, sink))
+        {
+            return glm::vec3(1.0f, 0.08f, 0.58f);
+        }
+        animating_ = animating_ || (sink.connected && sink.program.is_time_dependent());
+
+        const Rgb color = evaluate_sink(sink, current_time_seconds);
+        return glm::vec3(clamp(color.r, 0.f, 1.f), clamp(color.g, 0.f, 1.f), clamp(color.b, 0.f, 1.f));
+    }
 
-        } ui;
-    };
 
-    Graph<Node>            graph_;
-    std::vector<UiNode>    nodes_;
-    int                    root_node_id_;
+private:
+    Project                project_;
+    ChunkedProjectReader   reader_;
+    bool                   compress_projects_ = false;
+    bool                   show_statistics_ = false;
+    bool                   show_gpu_times_ = false;
+    // A node shown in the last frame depends on the time
+    bool                   animating_ = false;
+    // is_idle() at the end of the last frame
+    bool                   was_idle_ = false;
+    uint64_t               last_buffers_created_ = 0;
+    uint64_t               last_preview_renders_ = 0;
     ImNodesMiniMapLocation minimap_location_;
     bool showSphere;
+
+    // Grid space pixels around the canvas in which nodes are still drawn
+    static constexpr float cull_margin = 32.f;
+
+    // Layouts of the nodes drawn at least once; nodes without one are always
+    // drawn in full
+    std::unordered_map<int, NodeLayout> node_layouts_;
+    NodeLayout*                         layout_ = nullptr;
+    int                                 layout_node_ = -1;
+    ImVec2                              layout_origin_;
+    size_t                              nodes_submitted_ = 0;
+    size_t                              nodes_culled_ = 0;
+
+    // Texture nodes whose value waits for the image of their new path
+    std::vector<int> texture_means_pending_;
 };
@@ -0,0 +1,268 @@
+#pragma once
+
+#include <cmath>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "node.hpp"
+#include "graph.hpp"
+#include "project.hpp"
+
+struct Rgb
+{
+    float r, g, b;
+};
+
+// The part of the graph reachable from a sink, flattened into postorder. It is
+// compiled once and can then be evaluated for many points in time without
+// walking the graph again.
+class EvalProgram
+{
+public:
+    // Returns false if the graph below root_node contains a cycle.
+    bool compile(const Graph<Node>& graph, int root_node)
+    {
+        ops_.clear();
+        time_dependent_ = false;
+
+        const Span<const int> ids = graph.node_ids();
+        if (ids.begin() == ids.end())
+        {
+            return false;
+        }
+        // Ids come from the project file and need not be dense
+        std::unordered_set<int> on_path;
+
+        // Depth first, emitting a node once all of its neighbors are emitted.
+        // This is the order the original evaluate() popped its dfs stack in.
+        std::vector<std::pair<int, size_t>> stack;
+        stack.emplace_back(root_node, 0);
+        on_path.insert(root_node);
+
+        while (!stack.empty())
+        {
+            const int id = stack.back().first;
+            const Span<const int> neighbors = graph.neighbors(id);
+            const size_t next = stack.back().second;
+
+            if (neighbors.begin() + next != neighbors.end())
+            {
+                const int neighbor = *(neighbors.begin() + next);
+                stack.back().second += 1;
+                if (!on_path.insert(neighbor).second)
+                {
+                    ops_.clear();
+                    return false;
+                }
+                stack.emplace_back(neighbor, 0);
+                continue;
+            }
+
+            on_path.erase(id);
+            stack.pop_back();
+
+            const Node& node = graph.node(id);
+            switch (node.type)
+            {
+            case NodeType::value:
+                // A connected input takes its value from the node it links to
+                if (graph.num_edges_from_node(id) == 0ull)
+                {
+                    ops_.push_back({node.type, node.value});
+                }
+                break;
+            case NodeType::time:
+                time_dependent_ = true;
+                ops_.push_back({node.type, 0.f});
+                break;
+            case NodeType::texture:
+                // The mean brightness of the image, stored when its path was set
+                ops_.push_back({NodeType::value, node.value});
+                break;
+            case NodeType::add:
+            case NodeType::multiply:
+            case NodeType::sine:
+            case NodeType::power:
+                ops_.push_back({node.type, 0.f});
+                break;
+            default:
+                // Output and viewport nodes just leave their inputs on the stack
+                break;
+            }
+        }
+
+        return true;
+    }
+
+    // Evaluates the program and returns the number of values left on the stack.
+    size_t run(const float time_seconds)
+    {
+        stack_.clear();
+
+        for (const Op& op : ops_)
+        {
+            switch (op.type)
+            {
+            case NodeType::value:
+                stack_.push_back(op.value);
+                break;
+            case NodeType::time:
+                stack_.push_back(time_seconds);
+                break;
+            case NodeType::add:
+            {
+                const float rhs = pop();
+                const float lhs = pop();
+                stack_.push_back(lhs + rhs);
+            }
+            break;
+            case NodeType::multiply:
+            {
+                const float rhs = pop();
+                const float lhs = pop();
+                stack_.push_back(lhs * rhs);
+            }
+            break;
+            case NodeType::sine:
+                stack_.push_back(std::abs(std::sin(pop())));
+                break;
+            case NodeType::power:
+            {
+                const float rhs = pop();
+                const float lhs = pop();
+                stack_.push_back(std::pow(lhs, rhs));
+            }
+            break;
+            default:
+                break;
+            }
+        }
+
+        return stack_.size();
+    }
+
+    // Runs the program and reads the result as a color: three values are
+    // r, g and b, a single value is a grey level.
+    Rgb color(const float time_seconds, const Rgb fallback)
+    {
+        const size_t count = run(time_seconds);
+        if (count >= 3)
+        {
+            return {stack_[count - 3], stack_[count - 2], stack_[count - 1]};
+        }
+        if (count == 1)
+        {
+            return {stack_[0], stack_[0], stack_[0]};
+        }
+        return fallback;
+    }
+
+    bool empty() const { return ops_.empty(); }
+    bool is_time_dependent() const { return time_dependent_; }
+
+private:
+    float pop()
+    {
+        if (stack_.empty())
+        {
+            return 0.f;
+        }
+        const float value = stack_.back();
+        stack_.pop_back();
+        return value;
+    }
+
+    struct Op
+    {
+        NodeType type;
+        float    value;
+    };
+
+    std::vector<Op>    ops_;
+    std::vector<float> stack_;
+    bool               time_dependent_ = false;
+};
+
+// A node whose evaluated color is displayed: the output node or a viewport.
+struct Sink
+{
+    std::string name;
+    UiNodeType  type;
+    int         ui_node_id;
+    bool        connected;
+    EvalProgram program;
+};
+
+inline const Rgb unconnected_sink_color = {1.f, 1.f, 1.f};
+
+// Compiles the program of a single sink. A viewport whose input is not
+// linked shows a white object, like in the editor.
+inline bool compile_sink(const Project& project, const UiNode& node, Sink& sink)
+{
+    sink.type = node.type;
+    sink.ui_node_id = node.id;
+    sink.connected = false;
+
+    switch (node.type)
+    {
+    case UiNodeType::output:
+        sink.name = "output";
+        sink.connected = true;
+        return sink.program.compile(project.graph, node.id);
+    case UiNodeType::cubeviewport:
+    case UiNodeType::sphereviewport:
+    case UiNodeType::meshviewport:
+    {
+        const int input = ui_node_inputs(node)[0];
+        sink.name = (node.type == UiNodeType::cubeviewport     ? "cube"
+                     : node.type == UiNodeType::sphereviewport ? "sphere"
+                                                               : "mesh") +
+                    std::to_string(node.id);
+        sink.connected = project.graph.num_edges_from_node(input) > 0;
+        return !sink.connected || sink.program.compile(project.graph, input);
+    }
+    default:
+        return false;
+    }
+}
+
+inline Rgb evaluate_sink(Sink& sink, const float time_seconds)
+{
+    return sink.connected ? sink.program.color(time_seconds, unconnected_sink_color)
+                          : unconnected_sink_color;
+}
+
+// The output node followed by every viewport, in ui node order.
+inline bool collect_sinks(const Project& project, std::vector<Sink>& sinks)
+{
+    sinks.clear();
+
+    for (const UiNode& node : project.nodes)
+    {
+        if (node.type != UiNodeType::output && node.type != UiNodeType::cubeviewport &&
+            node.type != UiNodeType::sphereviewport && node.type != UiNodeType::meshviewport)
+        {
+            continue;
+        }
+
+        Sink sink;
+        if (!compile_sink(project, node, sink))
+        {
+            std::cerr << "Error: cannot evaluate node " << node.id << ", the graph has a cycle." << std::endl;
+            return false;
+        }
+
+        if (node.type == UiNodeType::output)
+        {
+            sinks.insert(sinks.begin(), std::move(sink));
+        }
+        else
+        {
+            sinks.push_back(std::move(sink));
+        }
+    }
+
+    return true;
+}
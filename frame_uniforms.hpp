@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+// Data shared by every preview draw of a frame, kept in one uniform buffer
+// at a fixed binding point, so the camera is uploaded once per frame instead
+// of once per draw. The layout is std140 and matches FRAME_DATA_GLSL.
+struct FrameData
+{
+    glm::mat4 projection;
+    glm::mat4 view;
+    float     time;
+    float     padding;
+    glm::vec2 viewport_size;
+};
+static_assert(sizeof(FrameData) == 144, "FrameData must match the std140 layout of the block");
+
+inline constexpr GLuint frame_data_binding = 0;
+
+// Declaration of the block for shader sources, to be pasted after #version
+#define FRAME_DATA_GLSL \
+    "layout(std140) uniform FrameData\n" \
+    "{\n" \
+    "    mat4 projection;\n" \
+    "    mat4 view;\n" \
+    "    float time;\n" \
+    "    vec2 viewportSize;\n" \
+    "};\n"
+
+class FrameUniformBuffer
+{
+public:
+    FrameUniformBuffer()
+    {
+        glGenBuffers(1, &m_ubo);
+        glBindBuffer(GL_UNIFORM_BUFFER, m_ubo);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameData), nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, frame_data_binding, m_ubo);
+    }
+
+    ~FrameUniformBuffer() { glDeleteBuffers(1, &m_ubo); }
+
+    FrameUniformBuffer(const FrameUniformBuffer&) = delete;
+    FrameUniformBuffer& operator=(const FrameUniformBuffer&) = delete;
+
+    // Uploads only when something changed, so repeated draws with the same
+    // camera and viewport cost nothing
+    void update(const FrameData& data)
+    {
+        if (m_valid && std::memcmp(&data, &m_data, sizeof(FrameData)) == 0)
+        {
+            return;
+        }
+
+        m_data = data;
+        m_valid = true;
+        glBindBuffer(GL_UNIFORM_BUFFER, m_ubo);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameData), &m_data);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        m_uploads += 1;
+    }
+
+    // The binding point is global state, other code may have reused it
+    void bind() const { glBindBufferBase(GL_UNIFORM_BUFFER, frame_data_binding, m_ubo); }
+
+    const FrameData& data() const { return m_data; }
+    uint64_t uploads() const { return m_uploads; }
+
+private:
+    GLuint    m_ubo = 0;
+    FrameData m_data = {};
+    bool      m_valid = false;
+    uint64_t  m_uploads = 0;
+};
@@ -1,7 +1,15 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <vector>
+#include <GL/glew.h>
 #include <glm/glm.hpp>
 
+#include "gl_state.hpp"
+
 class FrameBuffer
 {
 public:
@@ -18,12 +26,60 @@ public:
     int GetWidth() { return width; }
     int GetHeigth() { return height; }
 
+    // Makes the buffers hold at least width x height pixels, for a view
+    // that follows the size of its window. Sizes are rounded up to buckets
+    // of resizeStep pixels. Growing past the bucket reallocates at once,
+    // shrinking only once the size is two buckets below, so dragging a
+    // window edge back and forth does not reallocate every frame. The
+    // color texture has immutable storage where the driver supports it.
+    // Returns whether the buffers were reallocated.
+    bool ResizeToFit(int width, int height);
+    // Reallocations by ResizeToFit()
+    uint64_t GetReallocations() const { return reallocations; }
+
+    static constexpr int resizeStep = 128;
+
+    // Receives the RGBA8 pixels of a readback, bottom row first
+    using ReadbackCallback = std::function<void(std::vector<unsigned char>&& pixels, int width, int height)>;
+
+    // Starts copying the color buffer into a pixel buffer and returns
+    // without waiting for the GPU. The callback runs in a later
+    // PollReadbacks() once the copy is done. If all buffers of the ring are
+    // busy, this waits for the oldest one.
+    void ReadPixelsAsync(ReadbackCallback callback);
+    void ReadPixelsAsync(int x, int y, int width, int height, ReadbackCallback callback);
+    // Hands finished readbacks to their callbacks, call once per frame.
+    // With wait it blocks until all are done.
+    void PollReadbacks(bool wait = false);
+    size_t PendingReadbacks() const;
+
+    static constexpr size_t readbackRingSize = 3;
+
 private:
+    struct Readback
+    {
+        GLuint pbo = 0;
+        size_t capacity = 0;
+        GLsync fence = nullptr;
+        int width = 0;
+        int height = 0;
+        ReadbackCallback callback;
+    };
+
+    // Maps a finished readback and passes it on
+    void CompleteReadback(Readback& readback);
+    // Creates the buffers, or replaces them, at exactly width x height
+    void AllocateStorage(int width, int height);
+
     unsigned int fbo;
     unsigned int texture;
     unsigned int rbo;
     int width;
     int height;
+    std::vector<Readback> readbacks;
+    // Ring position of the next readback
+    size_t nextReadback = 0;
+    uint64_t reallocations = 0;
 };
 
 FrameBuffer::FrameBuffer() :
@@ -34,7 +90,7 @@ FrameBuffer::FrameBuffer() :
 FrameBuffer::FrameBuffer(float width, float height) : fbo(0), texture(0), rbo(0)
 {
     glGenFramebuffers(1, &fbo);
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    GlState::instance().bind_framebuffer(GL_FRAMEBUFFER, fbo);
 
     glGenTextures(1, &texture);
     glBindTexture(GL_TEXTURE_2D, texture);
@@ -52,7 +108,7 @@ FrameBuffer::FrameBuffer(float width, float height) : fbo(0), texture(0), rbo(0)
         std::cout << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!" << std::endl;
     }
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    GlState::instance().bind_framebuffer(GL_FRAMEBUFFER, 0);
     glBindTexture(GL_TEXTURE_2D, 0);
     glBindRenderbuffer(GL_RENDERBUFFER, 0);
 }
@@ -60,15 +116,26 @@ FrameBuffer::FrameBuffer(float width, float height) : fbo(0), texture(0), rbo(0)
 
 FrameBuffer::~FrameBuffer()
 {
+    GlState::instance().deleted_framebuffer(fbo);
     glDeleteFramebuffers(1, &fbo);
     glDeleteTextures(1, &texture);
     glDeleteRenderbuffers(1, &rbo);
+
+    // Callbacks of unfinished readbacks are dropped
+    for (Readback& readback : readbacks)
+    {
+        if (readback.fence)
+        {
+            glDeleteSync(readback.fence);
+        }
+        glDeleteBuffers(1, &readback.pbo);
+    }
 }
 
 void FrameBuffer::InitFrameBuffer(float width, float height) {
 
     glGenFramebuffers(1, &fbo);
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    GlState::instance().bind_framebuffer(GL_FRAMEBUFFER, fbo);
 
     glGenTextures(1, &texture);
     glBindTexture(GL_TEXTURE_2D, texture);
@@ -86,7 +153,7 @@ void FrameBuffer::InitFrameBuffer(float width, float height) {
         std::cout << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!" << std::endl;
     }
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    GlState::instance().bind_framebuffer(GL_FRAMEBUFFER, 0);
     glBindTexture(GL_TEXTURE_2D, 0);
     glBindRenderbuffer(GL_RENDERBUFFER, 0);
 
@@ -112,12 +179,184 @@ void FrameBuffer::RescaleFrameBuffer(float width, float height)
     glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rbo);
 }
 
+bool FrameBuffer::ResizeToFit(int width, int height)
+{
+    const auto bucket = [](const int size) { return std::max(1, (size + resizeStep - 1) / resizeStep) * resizeStep; };
+    const int bucketWidth = bucket(width);
+    const int bucketHeight = bucket(height);
+
+    const bool grow = bucketWidth > this->width || bucketHeight > this->height;
+    const bool shrink = bucketWidth <= this->width - 2 * resizeStep || bucketHeight <= this->height - 2 * resizeStep;
+    if (fbo != 0 && !grow && !shrink)
+    {
+        return false;
+    }
+
+    AllocateStorage(bucketWidth, bucketHeight);
+    reallocations += 1;
+    return true;
+}
+
+void FrameBuffer::AllocateStorage(int width, int height)
+{
+    if (fbo == 0)
+    {
+        glGenFramebuffers(1, &fbo);
+        glGenRenderbuffers(1, &rbo);
+    }
+
+    // Immutable storage cannot be respecified, a new size needs a new texture
+    glDeleteTextures(1, &texture);
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    if (GLEW_VERSION_4_2 || GLEW_ARB_texture_storage)
+    {
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGB8, width, height);
+    }
+    else
+    {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glBindRenderbuffer(GL_RENDERBUFFER, rbo);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    GlState& state = GlState::instance();
+    const GLuint previousFbo = state.framebuffer();
+    state.bind_framebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rbo);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cout << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!" << std::endl;
+    }
+    state.bind_framebuffer(GL_FRAMEBUFFER, previousFbo);
+
+    this->width = width;
+    this->height = height;
+}
+
 void FrameBuffer::Bind() const
 {
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    GlState::instance().bind_framebuffer(GL_FRAMEBUFFER, fbo);
 }
 
 void FrameBuffer::Unbind() const
 {
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    GlState::instance().bind_framebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void FrameBuffer::ReadPixelsAsync(ReadbackCallback callback)
+{
+    ReadPixelsAsync(0, 0, width, height, std::move(callback));
+}
+
+void FrameBuffer::ReadPixelsAsync(int x, int y, int width, int height, ReadbackCallback callback)
+{
+    if (readbacks.empty())
+    {
+        readbacks.resize(readbackRingSize);
+    }
+
+    Readback& readback = readbacks[nextReadback];
+    nextReadback = (nextReadback + 1) % readbacks.size();
+    if (readback.fence)
+    {
+        // The ring is full, finish the oldest readback first
+        glClientWaitSync(readback.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        CompleteReadback(readback);
+    }
+
+    const size_t size = static_cast<size_t>(width) * height * 4;
+    if (readback.pbo == 0)
+    {
+        glGenBuffers(1, &readback.pbo);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pbo);
+    if (readback.capacity < size)
+    {
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+        readback.capacity = size;
+    }
+
+    GlState& state = GlState::instance();
+    const GLuint previousFbo = state.framebuffer(GL_READ_FRAMEBUFFER);
+    GLint previousAlignment = 4;
+    glGetIntegerv(GL_PACK_ALIGNMENT, &previousAlignment);
+    state.bind_framebuffer(GL_READ_FRAMEBUFFER, fbo);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    // With a pack buffer bound the pointer is an offset and the call returns at once
+    glReadPixels(x, y, width, height, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glPixelStorei(GL_PACK_ALIGNMENT, previousAlignment);
+    state.bind_framebuffer(GL_READ_FRAMEBUFFER, previousFbo);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    readback.width = width;
+    readback.height = height;
+    readback.callback = std::move(callback);
+}
+
+void FrameBuffer::PollReadbacks(bool wait)
+{
+    // Oldest first, so callbacks run in the order the readbacks were started
+    for (size_t i = 0; i < readbacks.size(); ++i)
+    {
+        Readback& readback = readbacks[(nextReadback + i) % readbacks.size()];
+        if (!readback.fence)
+        {
+            continue;
+        }
+
+        const GLenum status = glClientWaitSync(readback.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0,
+                                               wait ? GL_TIMEOUT_IGNORED : 0);
+        if (status == GL_TIMEOUT_EXPIRED)
+        {
+            // Later readbacks cannot be done either
+            glFlush();
+            return;
+        }
+        CompleteReadback(readback);
+    }
+}
+
+size_t FrameBuffer::PendingReadbacks() const
+{
+    size_t pending = 0;
+    for (const Readback& readback : readbacks)
+    {
+        pending += readback.fence ? 1 : 0;
+    }
+    return pending;
+}
+
+void FrameBuffer::CompleteReadback(Readback& readback)
+{
+    glDeleteSync(readback.fence);
+    readback.fence = nullptr;
+
+    std::vector<unsigned char> pixels(static_cast<size_t>(readback.width) * readback.height * 4);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pbo);
+    const void* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, pixels.size(), GL_MAP_READ_BIT);
+    if (data)
+    {
+        std::copy_n(static_cast<const unsigned char*>(data), pixels.size(), pixels.data());
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    else
+    {
+        std::cerr << "ERROR::FRAMEBUFFER:: Cannot map readback buffer" << std::endl;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    ReadbackCallback callback = std::move(readback.callback);
+    readback.callback = nullptr;
+    if (callback && data)
+    {
+        callback(std::move(pixels), readback.width, readback.height);
+    }
 }
@@ -0,0 +1,238 @@
+#pragma once
+
+#include <cstdint>
+#include <GL/glew.h>
+
+struct GlStateStats
+{
+    // Calls passed to GL and calls dropped as redundant, of the last frame
+    uint64_t issued = 0;
+    uint64_t avoided = 0;
+    // Since the start
+    uint64_t total_issued = 0;
+    uint64_t total_avoided = 0;
+};
+
+// Remembers the program, vertex array, framebuffers, viewport, depth function
+// and a few capabilities set through it, and drops calls that would set them
+// to what they already are. The preview code leaves its state bound instead
+// of resetting it after every draw, so consecutive previews bind nothing.
+// State starts out unknown, the first call always reaches GL. Code that
+// changes this state behind its back has to call invalidate(), and objects
+// have to be reported when deleted, because GL reuses their names. ImGui's
+// renderer restores everything it changes, so it needs neither.
+class GlState
+{
+public:
+    // The state of the current context. Each process uses one context.
+    static GlState& instance()
+    {
+        static GlState state;
+        return state;
+    }
+
+    void use_program(const GLuint program)
+    {
+        if (!changed(m_program, program))
+        {
+            return;
+        }
+        glUseProgram(program);
+    }
+
+    void bind_vertex_array(const GLuint vao)
+    {
+        if (!changed(m_vertexArray, vao))
+        {
+            return;
+        }
+        glBindVertexArray(vao);
+    }
+
+    // GL_FRAMEBUFFER binds both the draw and the read framebuffer
+    void bind_framebuffer(const GLenum target, const GLuint fbo)
+    {
+        if (target == GL_FRAMEBUFFER)
+        {
+            if (m_drawFramebuffer == fbo && m_readFramebuffer == fbo)
+            {
+                m_avoided += 1;
+                return;
+            }
+            m_drawFramebuffer = fbo;
+            m_readFramebuffer = fbo;
+            m_issued += 1;
+        }
+        else if (!changed(target == GL_READ_FRAMEBUFFER ? m_readFramebuffer : m_drawFramebuffer, fbo))
+        {
+            return;
+        }
+        glBindFramebuffer(target, fbo);
+    }
+
+    // The bound framebuffer, without asking GL once it is known
+    GLuint framebuffer(const GLenum target = GL_DRAW_FRAMEBUFFER)
+    {
+        GLuint& bound = target == GL_READ_FRAMEBUFFER ? m_readFramebuffer : m_drawFramebuffer;
+        if (bound == unknown)
+        {
+            GLint fbo = 0;
+            glGetIntegerv(target == GL_READ_FRAMEBUFFER ? GL_READ_FRAMEBUFFER_BINDING : GL_DRAW_FRAMEBUFFER_BINDING,
+                          &fbo);
+            bound = static_cast<GLuint>(fbo);
+        }
+        return bound;
+    }
+
+    void viewport(const GLint x, const GLint y, const GLsizei width, const GLsizei height)
+    {
+        if (m_viewportKnown && m_viewport[0] == x && m_viewport[1] == y && m_viewport[2] == width &&
+            m_viewport[3] == height)
+        {
+            m_avoided += 1;
+            return;
+        }
+        m_viewport[0] = x;
+        m_viewport[1] = y;
+        m_viewport[2] = width;
+        m_viewport[3] = height;
+        m_viewportKnown = true;
+        m_issued += 1;
+        glViewport(x, y, width, height);
+    }
+
+    void depth_func(const GLenum function)
+    {
+        if (!changed(m_depthFunc, function))
+        {
+            return;
+        }
+        glDepthFunc(function);
+    }
+
+    void enable(const GLenum capability) { set_enabled(capability, true); }
+    void disable(const GLenum capability) { set_enabled(capability, false); }
+
+    void set_enabled(const GLenum capability, const bool enabled)
+    {
+        const int slot = capability_slot(capability);
+        if (slot >= 0)
+        {
+            const GLuint value = enabled ? 1 : 0;
+            if (!changed(m_capabilities[slot], value))
+            {
+                return;
+            }
+        }
+        else
+        {
+            m_issued += 1;
+        }
+        if (enabled)
+        {
+            glEnable(capability);
+        }
+        else
+        {
+            glDisable(capability);
+        }
+    }
+
+    // Deleting a bound object unbinds it, and its name may come back
+    void deleted_program(const GLuint program) { forget(m_program, program); }
+    void deleted_vertex_array(const GLuint vao) { forget(m_vertexArray, vao); }
+    void deleted_framebuffer(const GLuint fbo)
+    {
+        forget(m_drawFramebuffer, fbo);
+        forget(m_readFramebuffer, fbo);
+    }
+
+    // Forgets everything, e.g. after creating a context
+    void invalidate()
+    {
+        m_program = unknown;
+        m_vertexArray = unknown;
+        m_drawFramebuffer = unknown;
+        m_readFramebuffer = unknown;
+        m_depthFunc = unknown;
+        m_viewportKnown = false;
+        for (GLuint& capability : m_capabilities)
+        {
+            capability = unknown;
+        }
+    }
+
+    // Call once per frame, starts counting the calls of the new frame
+    void begin_frame()
+    {
+        m_stats.issued = m_issued;
+        m_stats.avoided = m_avoided;
+        m_stats.total_issued += m_issued;
+        m_stats.total_avoided += m_avoided;
+        m_issued = 0;
+        m_avoided = 0;
+    }
+
+    const GlStateStats& stats() const { return m_stats; }
+
+private:
+    static constexpr GLuint unknown = ~0u;
+
+    GlState() { invalidate(); }
+
+    // Capabilities that are tracked, others are always passed on
+    static int capability_slot(const GLenum capability)
+    {
+        switch (capability)
+        {
+        case GL_DEPTH_TEST:
+            return 0;
+        case GL_BLEND:
+            return 1;
+        case GL_CULL_FACE:
+            return 2;
+        case GL_SCISSOR_TEST:
+            return 3;
+        case GL_CLIP_DISTANCE0:
+        case GL_CLIP_DISTANCE1:
+        case GL_CLIP_DISTANCE2:
+        case GL_CLIP_DISTANCE3:
+            return 4 + static_cast<int>(capability - GL_CLIP_DISTANCE0);
+        default:
+            return -1;
+        }
+    }
+
+    // Counts the call and returns whether it has to reach GL
+    bool changed(GLuint& current, const GLuint value)
+    {
+        if (current == value)
+        {
+            m_avoided += 1;
+            return false;
+        }
+        current = value;
+        m_issued += 1;
+        return true;
+    }
+
+    static void forget(GLuint& current, const GLuint name)
+    {
+        if (current == name)
+        {
+            current = unknown;
+        }
+    }
+
+    GLuint       m_program;
+    GLuint       m_vertexArray;
+    GLuint       m_drawFramebuffer;
+    GLuint       m_readFramebuffer;
+    GLuint       m_depthFunc;
+    GLint        m_viewport[4] = {};
+    bool         m_viewportKnown = false;
+    GLuint       m_capabilities[8];
+    uint64_t     m_issued = 0;
+    uint64_t     m_avoided = 0;
+    GlStateStats m_stats;
+};
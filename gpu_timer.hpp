@@ -0,0 +1,295 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+// GPU time of one named pass, in milliseconds
+struct GpuPassTime
+{
+    std::string name;
+    double      last = 0.0;
+    double      average = 0.0;
+    double      max = 0.0;
+    uint64_t    samples = 0;
+};
+
+// Measures the GPU time of passes with GL_TIME_ELAPSED queries. Results are
+// read frames later from a ring of query sets, so measuring never waits for
+// the GPU; a set whose results are still not there when its slot comes round
+// again is dropped. Passes cannot nest, a pass begun inside another one is
+// not measured. Without timer query support, or with MATERIALEDITOR_GPU_TIMERS
+// set to 0, every call does nothing.
+class GpuTimer
+{
+public:
+    // Frames a query set may stay in flight
+    static constexpr size_t ring_size = 4;
+    // Frames kept for export
+    static constexpr size_t history_size = 600;
+
+    GpuTimer()
+    {
+        const char* enabled = std::getenv("MATERIALEDITOR_GPU_TIMERS");
+        if (enabled && std::string(enabled) == "0")
+        {
+            return;
+        }
+        if (GLEW_VERSION_3_3 || GLEW_ARB_timer_query)
+        {
+            // Drivers may expose the query with a counter of 0 bits
+            GLint bits = 0;
+            glGetQueryiv(GL_TIME_ELAPSED, GL_QUERY_COUNTER_BITS, &bits);
+            m_supported = bits > 0;
+        }
+        if (!m_supported)
+        {
+            std::cerr << "[INFO] GPU timer queries are not supported, pass times are not measured" << std::endl;
+        }
+    }
+
+    ~GpuTimer()
+    {
+        for (Frame& frame : m_frames)
+        {
+            if (!frame.queries.empty())
+            {
+                glDeleteQueries(static_cast<GLsizei>(frame.queries.size()), frame.queries.data());
+            }
+        }
+    }
+
+    GpuTimer(const GpuTimer&) = delete;
+    GpuTimer& operator=(const GpuTimer&) = delete;
+
+    // Ends a pass when it goes out of scope
+    class Scope
+    {
+    public:
+        Scope(GpuTimer& timer, const char* name) : m_timer(timer), m_begun(timer.begin(name)) {}
+        ~Scope()
+        {
+            if (m_begun)
+            {
+                m_timer.end();
+            }
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        GpuTimer& m_timer;
+        bool      m_begun;
+    };
+
+    bool supported() const { return m_supported; }
+
+    // Collects the finished results of earlier frames and starts a new one,
+    // call once per frame before the first pass
+    void begin_frame()
+    {
+        if (!m_supported)
+        {
+            return;
+        }
+
+        if (m_active)
+        {
+            end();
+        }
+        for (size_t i = 1; i <= ring_size; ++i)
+        {
+            collect(m_frames[(m_current + i) % ring_size]);
+        }
+
+        m_current = (m_current + 1) % ring_size;
+        Frame& frame = m_frames[m_current];
+        if (frame.used > 0)
+        {
+            // Still not finished after a whole ring of frames
+            m_dropped += 1;
+        }
+        frame.used = 0;
+        frame.number = m_frame_number++;
+        frame.started = std::chrono::steady_clock::now();
+    }
+
+    // Returns whether the pass is measured, end() has to follow only then
+    bool begin(const char* name)
+    {
+        if (!m_supported || m_active)
+        {
+            return false;
+        }
+
+        Frame& frame = m_frames[m_current];
+        if (frame.used == frame.queries.size())
+        {
+            GLuint query = 0;
+            glGenQueries(1, &query);
+            frame.queries.push_back(query);
+            frame.passes.push_back(0);
+        }
+        frame.passes[frame.used] = pass_index(name);
+        glBeginQuery(GL_TIME_ELAPSED, frame.queries[frame.used]);
+        frame.used += 1;
+        m_active = true;
+        return true;
+    }
+
+    void end()
+    {
+        if (m_active)
+        {
+            glEndQuery(GL_TIME_ELAPSED);
+            m_active = false;
+        }
+    }
+
+    // In the order the passes were first measured
+    const std::vector<GpuPassTime>& passes() const { return m_passes; }
+    // Query sets whose results came too late
+    uint64_t dropped() const { return m_dropped; }
+    // Results the driver got wrong
+    uint64_t invalid() const { return m_invalid; }
+
+    // Writes the kept frames as CSV, one row per frame and a column per pass
+    bool export_csv(const std::string& filename) const
+    {
+        std::ofstream file(filename);
+        if (!file.is_open())
+        {
+            std::cerr << "[WARN] Cannot write " << filename << std::endl;
+            return false;
+        }
+
+        file << "frame";
+        for (const GpuPassTime& pass : m_passes)
+        {
+            file << "," << pass.name << "_ms";
+        }
+        file << "\n";
+        for (const Sample& sample : m_history)
+        {
+            file << sample.frame;
+            for (size_t pass = 0; pass < m_passes.size(); ++pass)
+            {
+                file << ",";
+                if (pass < sample.milliseconds.size() && sample.milliseconds[pass] >= 0.0)
+                {
+                    file << sample.milliseconds[pass];
+                }
+            }
+            file << "\n";
+        }
+        return static_cast<bool>(file);
+    }
+
+private:
+    struct Frame
+    {
+        std::vector<GLuint> queries;
+        std::vector<size_t> passes;
+        size_t              used = 0;
+        uint64_t            number = 0;
+        std::chrono::steady_clock::time_point started;
+    };
+
+    // Pass times of one frame, -1 for passes it did not run
+    struct Sample
+    {
+        uint64_t            frame = 0;
+        std::vector<double> milliseconds;
+    };
+
+    size_t pass_index(const char* name)
+    {
+        for (size_t i = 0; i < m_passes.size(); ++i)
+        {
+            if (m_passes[i].name == name)
+            {
+                return i;
+            }
+        }
+        m_passes.push_back({name});
+        return m_passes.size() - 1;
+    }
+
+    // Reads the results of frame if all of them are available
+    void collect(Frame& frame)
+    {
+        if (frame.used == 0)
+        {
+            return;
+        }
+        // Results become available in order, the last query decides
+        GLuint available = 0;
+        glGetQueryObjectuiv(frame.queries[frame.used - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+        {
+            return;
+        }
+
+        // No pass can take longer than the time since its frame began. Some
+        // drivers (llvmpipe) return a timestamp for a query that spans a
+        // framebuffer switch, such results are ignored.
+        const double limit = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() -
+                                                                       frame.started).count();
+
+        Sample sample;
+        sample.frame = frame.number;
+        sample.milliseconds.assign(m_passes.size(), -1.0);
+        for (size_t i = 0; i < frame.used; ++i)
+        {
+            GLuint64 nanoseconds = 0;
+            glGetQueryObjectui64v(frame.queries[i], GL_QUERY_RESULT, &nanoseconds);
+            if (nanoseconds * 1e-6 > limit)
+            {
+                m_invalid += 1;
+                continue;
+            }
+            double& milliseconds = sample.milliseconds[frame.passes[i]];
+            // A pass measured twice in a frame counts once with both times
+            milliseconds = std::max(milliseconds, 0.0) + nanoseconds * 1e-6;
+        }
+        frame.used = 0;
+
+        for (size_t pass = 0; pass < m_passes.size(); ++pass)
+        {
+            if (sample.milliseconds[pass] < 0.0)
+            {
+                continue;
+            }
+            GpuPassTime& time = m_passes[pass];
+            time.last = sample.milliseconds[pass];
+            time.samples += 1;
+            // Moving average over about the last 30 frames
+            time.average = time.samples == 1 ? time.last : time.average + (time.last - time.average) / 30.0;
+            time.max = std::max(time.max, time.last);
+        }
+
+        if (m_history.size() == history_size)
+        {
+            m_history.pop_front();
+        }
+        m_history.push_back(std::move(sample));
+    }
+
+    bool                     m_supported = false;
+    bool                     m_active = false;
+    Frame                    m_frames[ring_size];
+    size_t                   m_current = 0;
+    uint64_t                 m_frame_number = 0;
+    uint64_t                 m_dropped = 0;
+    uint64_t                 m_invalid = 0;
+    std::vector<GpuPassTime> m_passes;
+    std::deque<Sample>       m_history;
+};
@@ -41,6 +41,7 @@ public:
     // Element access
 
     Span<const ElementType> elements() const { return elements_; }
+    Span<const int>         ids() const { return sorted_ids_; }
 
     // Capacity
 
@@ -187,6 +188,7 @@ public:
     const NodeType&  node(int node_id) const;
     Span<const int>  neighbors(int node_id) const;
     Span<const Edge> edges() const;
+    Span<const int>  node_ids() const;
 
     // Capacity
 
@@ -200,7 +202,17 @@ public:
     int  insert_edge(int from, int to);
     void erase_edge(int edge_id);
 
+    // Insert with a known id, e.g. when restoring a saved project
+    void insert_node(int node_id, const NodeType& node);
+    void insert_edge(int edge_id, int from, int to);
+
     bool node_exists(const int id) const;
+    bool edge_exists(const int id) const;
+
+    // Ids below next_id are never handed out again, even if they are not in
+    // the graph (yet)
+    int  next_id() const { return current_id_; }
+    void reserve_ids(const int next_id) { current_id_ = std::max(current_id_, next_id); }
 
 private:
     int current_id_;
@@ -241,6 +253,12 @@ Span<const typename Graph<NodeType>::Edge> Graph<NodeType>::edges() const
     return edges_.elements();
 }
 
+template<typename NodeType>
+Span<const int> Graph<NodeType>::node_ids() const
+{
+    return nodes_.ids();
+}
+
 template<typename NodeType>
 size_t Graph<NodeType>::num_edges_from_node(const int id) const
 {
@@ -255,15 +273,28 @@ bool Graph<NodeType>::node_exists(const int id) const
     return nodes_.contains(id);
 }
 
+template<typename NodeType>
+bool Graph<NodeType>::edge_exists(const int id) const
+{
+    return edges_.contains(id);
+}
+
 template<typename NodeType>
 int Graph<NodeType>::insert_node(const NodeType& node)
 {
-    const int id = current_id_++;
+    const int id = current_id_;
+    insert_node(id, node);
+    return id;
+}
+
+template<typename NodeType>
+void Graph<NodeType>::insert_node(const int id, const NodeType& node)
+{
     assert(!nodes_.contains(id));
+    current_id_ = std::max(current_id_, id + 1);
     nodes_.insert(id, node);
     edges_from_node_.insert(id, 0);
     node_neighbors_.insert(id, std::vector<int>());
-    return id;
 }
 
 template<typename NodeType>
@@ -298,10 +329,18 @@ void Graph<NodeType>::erase_node(const int id)
 template<typename NodeType>
 int Graph<NodeType>::insert_edge(const int from, const int to)
 {
-    const int id = current_id_++;
+    const int id = current_id_;
+    insert_edge(id, from, to);
+    return id;
+}
+
+template<typename NodeType>
+void Graph<NodeType>::insert_edge(const int id, const int from, const int to)
+{
     assert(!edges_.contains(id));
     assert(nodes_.contains(from));
     assert(nodes_.contains(to));
+    current_id_ = std::max(current_id_, id + 1);
     edges_.insert(id, Edge(id, from, to));
 
     // update neighbor count
@@ -310,8 +349,6 @@ int Graph<NodeType>::insert_edge(const int from, const int to)
     // update neighbor list
     assert(node_neighbors_.contains(from));
     node_neighbors_.find(from)->push_back(to);
-
-    return id;
 }
 
 template<typename NodeType>
@@ -0,0 +1,7 @@
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "headless.hpp"
+
+int main(int argc, char** argv)
+{
+    return run_headless(argc, argv);
+}
@@ -0,0 +1,325 @@
+#pragma once
+
+// Command line evaluator: loads projects and samples the output and viewport
+// sinks over a time range without creating a window or a GL context.
+
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "project_chunks.hpp"
+#include "evaluator.hpp"
+#include "thread_pool.hpp"
+#include "bench_io.hpp"
+#include "bench_mesh.hpp"
+
+enum class HeadlessFormat
+{
+    csv,
+    binary
+};
+
+struct HeadlessOptions
+{
+    float                    start = 0.f;
+    float                    end = 1.f;
+    float                    step = 1.f / 30.f;
+    HeadlessFormat           format = HeadlessFormat::csv;
+    std::string              output_dir;
+    size_t                   jobs = std::thread::hardware_concurrency();
+    std::vector<std::string> projects;
+};
+
+inline void print_headless_usage()
+{
+    std::cerr << "usage: materialeditor-headless [options] project.json...\n"
+                 "  --start <seconds>  first sample time (default 0)\n"
+                 "  --end <seconds>    last sample time (default 1)\n"
+                 "  --step <seconds>   time between samples (default 1/30)\n"
+                 "  --format csv|bin   result format (default csv)\n"
+                 "  --output <dir>     result directory (default: next to each project)\n"
+                 "  --jobs <n>         projects evaluated in parallel (default: all cores)\n"
+                 "\n"
+                 "Results are written to the project file name with .csv or .bin appended.\n"
+                 "Each project writes one row per sample: the time followed by r, g, b of the\n"
+                 "output node and of every viewport node, clamped to [0, 1] as displayed.\n"
+                 "The bin format is: \"MEVB\", uint32 version, uint32 channel count,\n"
+                 "uint32 sample count, the channel names as uint32 length + bytes, then the\n"
+                 "rows as float32 in host byte order.\n"
+                 "\n"
+                 "materialeditor-headless --bench-io compares the project file formats.\n"
+                 "materialeditor-headless --bench-mesh compares OBJ parsing with the mesh cache.\n";
+}
+
+inline bool parse_headless_options(int argc, char** argv, HeadlessOptions& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+
+        if (arg == "--headless")
+        {
+            continue;
+        }
+        else if (arg == "--start" && has_value)
+        {
+            options.start = std::stof(argv[++i]);
+        }
+        else if (arg == "--end" && has_value)
+        {
+            options.end = std::stof(argv[++i]);
+        }
+        else if (arg == "--step" && has_value)
+        {
+            options.step = std::stof(argv[++i]);
+        }
+        else if (arg == "--format" && has_value)
+        {
+            const std::string format = argv[++i];
+            if (format == "csv")
+            {
+                options.format = HeadlessFormat::csv;
+            }
+            else if (format == "bin")
+            {
+                options.format = HeadlessFormat::binary;
+            }
+            else
+            {
+                std::cerr << "Unknown format " << format << std::endl;
+                return false;
+            }
+        }
+        else if (arg == "--output" && has_value)
+        {
+            options.output_dir = argv[++i];
+        }
+        else if (arg == "--jobs" && has_value)
+        {
+            options.jobs = std::stoul(argv[++i]);
+        }
+        else if (!arg.empty() && arg[0] == '-')
+        {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return false;
+        }
+        else
+        {
+            options.projects.push_back(arg);
+        }
+    }
+
+    if (options.projects.empty() || options.step <= 0.f || options.end < options.start)
+    {
+        return false;
+    }
+
+    return true;
+}
+
+inline void append_float(std::string& out, const float value)
+{
+    char buffer[32];
+    const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, result.ptr);
+}
+
+template<typename T>
+void append_binary(std::string& out, const T value)
+{
+    char bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    out.append(bytes, sizeof(T));
+}
+
+// The result file of a project is its file name with .csv or .bin appended,
+// so x.json and x.mep do not write to the same file
+inline std::filesystem::path headless_output_path(const std::string& filename, const HeadlessOptions& options)
+{
+    std::filesystem::path path(filename);
+    path += options.format == HeadlessFormat::csv ? ".csv" : ".bin";
+    if (!options.output_dir.empty())
+    {
+        path = std::filesystem::path(options.output_dir) / path.filename();
+    }
+    return path;
+}
+
+inline bool evaluate_project(const std::string& filename, const HeadlessOptions& options)
+{
+    // Runs on a worker of the batch pool, so the chunks are decoded here
+    // rather than on another pool of their own
+    Project project;
+    if (!load_project_file(project, filename, nullptr))
+    {
+        return false;
+    }
+
+    std::vector<Sink> sinks;
+    if (!collect_sinks(project, sinks))
+    {
+        return false;
+    }
+
+    const size_t samples = static_cast<size_t>((options.end - options.start) / options.step + 1e-4f) + 1;
+    const uint32_t channels = static_cast<uint32_t>(sinks.size() * 3);
+
+    // The whole result is built in memory and written with a single call
+    std::string out;
+    if (options.format == HeadlessFormat::csv)
+    {
+        out.reserve(16 + samples * (1 + channels) * 10);
+        out += "time";
+        for (const Sink& sink : sinks)
+        {
+            out += "," + sink.name + ".r," + sink.name + ".g," + sink.name + ".b";
+        }
+        out += '\n';
+    }
+    else
+    {
+        out.reserve(16 + sinks.size() * 16 + samples * (1 + channels) * sizeof(float));
+        out.append("MEVB", 4);
+        append_binary<uint32_t>(out, 1);
+        append_binary<uint32_t>(out, channels);
+        append_binary<uint32_t>(out, static_cast<uint32_t>(samples));
+        for (const Sink& sink : sinks)
+        {
+            for (const char* channel : {".r", ".g", ".b"})
+            {
+                const std::string name = sink.name + channel;
+                append_binary<uint32_t>(out, static_cast<uint32_t>(name.size()));
+                out += name;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < samples; ++i)
+    {
+        const float time = options.start + options.step * static_cast<float>(i);
+
+        if (options.format == HeadlessFormat::csv)
+        {
+            append_float(out, time);
+        }
+        else
+        {
+            append_binary(out, time);
+        }
+
+        for (Sink& sink : sinks)
+        {
+            const Rgb color = evaluate_sink(sink, time);
+            for (const float value : {color.r, color.g, color.b})
+            {
+                const float clamped = std::min(1.f, std::max(value, 0.f));
+                if (options.format == HeadlessFormat::csv)
+                {
+                    out += ',';
+                    append_float(out, clamped);
+                }
+                else
+                {
+                    append_binary(out, clamped);
+                }
+            }
+        }
+
+        if (options.format == HeadlessFormat::csv)
+        {
+            out += '\n';
+        }
+    }
+
+    const std::filesystem::path path = headless_output_path(filename, options);
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open() || !file.write(out.data(), static_cast<std::streamsize>(out.size())))
+    {
+        std::cerr << "Error: cannot write " << path << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+inline int run_headless(int argc, char** argv)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::string(argv[i]) == "--bench-io")
+        {
+            return run_bench_io(argc, argv);
+        }
+        if (std::string(argv[i]) == "--bench-mesh")
+        {
+            return run_bench_mesh(argc, argv);
+        }
+    }
+
+    HeadlessOptions options;
+    try
+    {
+        if (!parse_headless_options(argc, argv, options))
+        {
+            print_headless_usage();
+            return 1;
+        }
+    }
+    catch (const std::exception&)
+    {
+        print_headless_usage();
+        return 1;
+    }
+
+    // Projects with the same file name in different directories would
+    // overwrite each other's results in --output
+    std::map<std::filesystem::path, const std::string*> outputs;
+    for (const std::string& project : options.projects)
+    {
+        const std::filesystem::path path = headless_output_path(project, options).lexically_normal();
+        const auto [iter, inserted] = outputs.emplace(path, &project);
+        if (!inserted)
+        {
+            std::cerr << "Error: " << *iter->second << " and " << project << " would both write " << path.string()
+                      << std::endl;
+            return 1;
+        }
+    }
+
+    if (!options.output_dir.empty())
+    {
+        std::error_code error;
+        std::filesystem::create_directories(options.output_dir, error);
+    }
+
+    std::vector<std::future<bool>> results;
+    results.reserve(options.projects.size());
+    {
+        ThreadPool pool(std::min(options.jobs, options.projects.size()));
+        for (const std::string& project : options.projects)
+        {
+            results.push_back(pool.submit([&options, &project] { return evaluate_project(project, options); }));
+        }
+    }
+
+    size_t failed = 0;
+    for (auto& result : results)
+    {
+        failed += result.get() ? 0 : 1;
+    }
+
+    if (failed > 0)
+    {
+        std::cerr << failed << " of " << options.projects.size() << " projects failed." << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,236 @@
+#pragma once
+
+// A small implementation of the LZ4 block format
+// (https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md), used to
+// compress the chunks of project files. The output can be decoded by any LZ4
+// block decoder and the decoder accepts blocks written by the reference
+// library. Frames, dictionaries and the high compression modes are not
+// needed here and not implemented.
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace lz4
+{
+
+inline constexpr size_t min_match = 4;
+// The last match has to start 12 bytes before the end of the block, and the
+// last 5 bytes are always literals
+inline constexpr size_t match_start_limit = 12;
+inline constexpr size_t last_literals = 5;
+inline constexpr size_t max_offset = 65535;
+inline constexpr int    hash_bits = 14;
+
+inline size_t compress_bound(const size_t size)
+{
+    return size + size / 255 + 16;
+}
+
+// Largest size a block of size bytes can decode to: each byte adds at most
+// 255 to a match length
+inline uint64_t decompress_bound(const uint64_t size)
+{
+    return size * 255 + 24;
+}
+
+inline uint32_t read32(const uint8_t* p)
+{
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline uint32_t hash(const uint32_t sequence)
+{
+    return (sequence * 2654435761u) >> (32 - hash_bits);
+}
+
+inline void write_length(std::vector<uint8_t>& out, size_t length)
+{
+    while (length >= 255)
+    {
+        out.push_back(255);
+        length -= 255;
+    }
+    out.push_back(static_cast<uint8_t>(length));
+}
+
+inline void write_sequence(
+    std::vector<uint8_t>& out, const uint8_t* literals, const size_t literal_length, const size_t offset,
+    const size_t match_length)
+{
+    const size_t match_code = match_length >= min_match ? match_length - min_match : 0;
+    const uint8_t token = static_cast<uint8_t>((literal_length >= 15 ? 15 : literal_length) << 4 |
+                                               (match_code >= 15 ? 15 : match_code));
+    out.push_back(token);
+    if (literal_length >= 15)
+    {
+        write_length(out, literal_length - 15);
+    }
+    if (literal_length > 0)
+    {
+        out.insert(out.end(), literals, literals + literal_length);
+    }
+
+    // The last sequence of a block has literals only
+    if (match_length == 0)
+    {
+        return;
+    }
+
+    out.push_back(static_cast<uint8_t>(offset));
+    out.push_back(static_cast<uint8_t>(offset >> 8));
+    if (match_code >= 15)
+    {
+        write_length(out, match_code - 15);
+    }
+}
+
+// Greedy single pass compressor with a hash table of the last position of
+// every 4 byte sequence. Regions without matches are skipped in growing steps.
+inline std::vector<uint8_t> compress(const uint8_t* src, const size_t size)
+{
+    std::vector<uint8_t> out;
+    out.reserve(compress_bound(size));
+
+    size_t anchor = 0;
+    if (size > match_start_limit)
+    {
+        std::vector<uint32_t> table(size_t(1) << hash_bits, 0);
+        const size_t match_limit = size - match_start_limit;
+        const size_t end_of_matches = size - last_literals;
+
+        // Position 0 cannot be a match candidate, so 0 marks an empty slot
+        size_t pos = 1;
+        size_t misses = 0;
+
+        while (pos <= match_limit)
+        {
+            const uint32_t sequence = read32(src + pos);
+            const uint32_t h = hash(sequence);
+            const size_t candidate = table[h];
+            table[h] = static_cast<uint32_t>(pos);
+
+            if (candidate == 0 || pos - candidate > max_offset || read32(src + candidate) != sequence)
+            {
+                pos += 1 + (misses++ >> 6);
+                continue;
+            }
+            misses = 0;
+
+            size_t match_length = min_match;
+            while (pos + match_length < end_of_matches && src[candidate + match_length] == src[pos + match_length])
+            {
+                ++match_length;
+            }
+
+            write_sequence(out, src + anchor, pos - anchor, pos - candidate, match_length);
+            pos += match_length;
+            anchor = pos;
+
+            if (pos <= match_limit)
+            {
+                table[hash(read32(src + pos - 2))] = static_cast<uint32_t>(pos - 2);
+            }
+        }
+    }
+
+    write_sequence(out, src + anchor, size - anchor, 0, 0);
+    return out;
+}
+
+// Decodes a block into exactly dst_size bytes. Returns false for corrupt or
+// truncated input instead of reading or writing out of bounds.
+inline bool decompress(const uint8_t* src, const size_t size, uint8_t* dst, const size_t dst_size)
+{
+    size_t in = 0;
+    size_t out = 0;
+
+    while (in < size)
+    {
+        const uint8_t token = src[in++];
+
+        size_t literal_length = token >> 4;
+        if (literal_length == 15)
+        {
+            uint8_t byte;
+            do
+            {
+                if (in >= size)
+                {
+                    return false;
+                }
+                byte = src[in++];
+                literal_length += byte;
+            } while (byte == 255);
+        }
+
+        if (literal_length > size - in || literal_length > dst_size - out)
+        {
+            return false;
+        }
+        if (literal_length > 0)
+        {
+            std::memcpy(dst + out, src + in, literal_length);
+        }
+        in += literal_length;
+        out += literal_length;
+
+        if (in == size)
+        {
+            break;
+        }
+
+        if (size - in < 2)
+        {
+            return false;
+        }
+        const size_t offset = src[in] | static_cast<size_t>(src[in + 1]) << 8;
+        in += 2;
+        if (offset == 0 || offset > out)
+        {
+            return false;
+        }
+
+        size_t match_length = token & 15;
+        if (match_length == 15)
+        {
+            uint8_t byte;
+            do
+            {
+                if (in >= size)
+                {
+                    return false;
+                }
+                byte = src[in++];
+                match_length += byte;
+            } while (byte == 255);
+        }
+        match_length += min_match;
+
+        if (match_length > dst_size - out)
+        {
+            return false;
+        }
+
+        const uint8_t* match = dst + out - offset;
+        if (offset >= match_length)
+        {
+            std::memcpy(dst + out, match, match_length);
+        }
+        else
+        {
+            // Overlapping copy repeats the last offset bytes
+            for (size_t i = 0; i < match_length; ++i)
+            {
+                dst[out + i] = match[i];
+            }
+        }
+        out += match_length;
+    }
+
+    return out == dst_size;
+}
+
+} // namespace lz4
@@ -1,4 +1,5 @@
 #include <iostream>
+#include <memory>
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include "imgui.h"
@@ -8,8 +9,18 @@
 #include "imnodes.h"
 
 #include "3rdparty/imnodes/imnodes.h"
+#define TINYOBJLOADER_IMPLEMENTATION
+#define STB_IMAGE_IMPLEMENTATION
 #include "editor.hpp"
+#include "gl_state.hpp"
+#include "shader.hpp"
+#include "shader_compile_worker.hpp"
 #include "node.hpp"
+#include "headless.hpp"
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "bake.hpp"
+#include "bench_previews.hpp"
 
 GLFWwindow* initializeWindow() {
     if (!glfwInit()) {
@@ -42,6 +53,52 @@ GLFWwindow* initializeWindow() {
     return window;
 }
 
+// Without parallel shader compile in the driver, programs are compiled on a
+// thread with the context of a hidden window that shares objects with the
+// main one. Returns that window, or null where it is not needed or could not
+// be created; Shader then compiles on the main thread.
+GLFWwindow* startCompileWorker(GLFWwindow* window) {
+    if (Shader::parallelCompile()) {
+        return nullptr;
+    }
+
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow* hidden = glfwCreateWindow(1, 1, "", nullptr, window);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+    if (!hidden) {
+        std::cerr << "[WARN] No shared context for compiling shaders, compiling on the main thread" << std::endl;
+        return nullptr;
+    }
+
+    ShaderCompileWorker::instance().start([hidden] { glfwMakeContextCurrent(hidden); },
+                                          [] { glfwMakeContextCurrent(nullptr); });
+    return hidden;
+}
+
+// Frames drawn at full rate after the last input event. ImGui needs a few to
+// settle hover states and window sizes.
+static constexpr int activeFramesAfterInput = 3;
+// An idle editor still redraws this often, e.g. for the text cursor
+static constexpr double idleTimeoutSeconds = 0.5;
+static int activeFrames = activeFramesAfterInput;
+
+static void wakeOnInput() {
+    activeFrames = activeFramesAfterInput;
+}
+
+// Installed before ImGui's callbacks, which call them in turn
+void installInputCallbacks(GLFWwindow* window) {
+    glfwSetCursorPosCallback(window, [](GLFWwindow*, double, double) { wakeOnInput(); });
+    glfwSetMouseButtonCallback(window, [](GLFWwindow*, int, int, int) { wakeOnInput(); });
+    glfwSetScrollCallback(window, [](GLFWwindow*, double, double) { wakeOnInput(); });
+    glfwSetKeyCallback(window, [](GLFWwindow*, int, int, int, int) { wakeOnInput(); });
+    glfwSetCharCallback(window, [](GLFWwindow*, unsigned int) { wakeOnInput(); });
+    glfwSetCursorEnterCallback(window, [](GLFWwindow*, int) { wakeOnInput(); });
+    glfwSetWindowFocusCallback(window, [](GLFWwindow*, int) { wakeOnInput(); });
+    glfwSetFramebufferSizeCallback(window, [](GLFWwindow*, int, int) { wakeOnInput(); });
+    glfwSetWindowRefreshCallback(window, [](GLFWwindow*) { wakeOnInput(); });
+}
+
 void setupDockSpace() {
    // ImGui::DockSpaceOverViewport(ImGui::GetMainViewport(), ImGuiDockNodeFlags_None);
 
@@ -61,9 +118,22 @@ void setupDockSpace() {
     }*/
 }
 
-int main() {
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) == "--headless") {
+            return run_headless(argc, argv);
+        }
+        if (std::string(argv[i]) == "--bake") {
+            return run_bake(argc, argv);
+        }
+        if (std::string(argv[i]) == "--bench-previews") {
+            return run_bench_previews(argc, argv);
+        }
+    }
+
     GLFWwindow* window = initializeWindow();
     if (!window) return -1;
+    GLFWwindow* compileWindow = startCompileWorker(window);
 
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
@@ -74,33 +144,48 @@ int main() {
     //io.ConfigFlags |= ImGuiConfigFlags_ViewportsEnable;
     //io.ConfigFlags |= ImGuiConfigFlags_DockingEnable;         // Enable Docking
 
+    installInputCallbacks(window);
     ImGui_ImplGlfw_InitForOpenGL(window, true);
     ImGui_ImplOpenGL3_Init("#version 330"); // GLSL verze 3.3
 
     ImNodes::CreateContext();
 
-    NodeEditor editor;
+    // Owns GL objects, so it is destroyed while the context still exists
+    auto editor = std::make_unique<NodeEditor>();
 
     while (!glfwWindowShouldClose(window)) {
-        glfwPollEvents();
+        // Sleeps until input arrives while nothing on screen changes
+        if (activeFrames > 0 || !editor->is_idle()) {
+            glfwPollEvents();
+        } else {
+            glfwWaitEventsTimeout(idleTimeoutSeconds);
+        }
+        activeFrames = std::max(activeFrames - 1, 0);
+
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
 
-        editor.show();
+        editor->show();
 
         ImGui::Render();
         int display_w, display_h;
         glfwGetFramebufferSize(window, &display_w, &display_h);
-        glViewport(0, 0, display_w, display_h);
+        GlState::instance().viewport(0, 0, display_w, display_h);
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        {
+            GpuTimer::Scope pass(editor->gpu_timer(), "imgui");
+            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        }
 
         glfwSwapBuffers(window);
     }
 
     // Cleanup
+    editor.reset();
+    ShaderCompileWorker::instance().stop();
+    if (compileWindow) glfwDestroyWindow(compileWindow);
     ImNodes::DestroyContext();
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
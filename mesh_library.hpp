@@ -0,0 +1,200 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <glm/glm.hpp>
+
+#include "mesh_loader.hpp"
+#include "mesh_manager.hpp"
+#include "thread_pool.hpp"
+
+enum class MeshState
+{
+    loading,
+    ready,
+    failed
+};
+
+struct MeshLibraryStats
+{
+    size_t   meshes = 0;
+    size_t   loading = 0;
+    size_t   triangles = 0;
+    uint64_t loads_from_cache = 0;
+    uint64_t loads_from_obj = 0;
+    double   load_milliseconds = 0.0;
+};
+
+// The meshes shown by mesh viewport nodes, one per file however many nodes
+// show it. Files are read and parsed on worker threads; poll() uploads the
+// finished ones on the GL thread, so the editor never waits for a file.
+// Meshes stay uploaded until clear(), a node that is deleted and added again
+// does not load again.
+class MeshLibrary
+{
+public:
+    struct Entry
+    {
+        MeshState   state = MeshState::loading;
+        MeshHandle  handle;
+        // Center in xyz and scale in w, which fit the mesh into the preview
+        // like the cube
+        glm::vec4   fit = glm::vec4(0.f, 0.f, 0.f, 1.f);
+        size_t      triangles = 0;
+        std::string error;
+    };
+
+    // Uploads into meshes, which has to outlive the library
+    explicit MeshLibrary(MeshManager& meshes, size_t threads = 2) : m_meshes(meshes), m_threads(threads) {}
+
+    ~MeshLibrary()
+    {
+        // Only the loads already running are waited for
+        clear();
+        m_pool.reset();
+    }
+
+    MeshLibrary(const MeshLibrary&) = delete;
+    MeshLibrary& operator=(const MeshLibrary&) = delete;
+
+    // Starts loading path unless it is loaded or loading already. The entry
+    // stays valid until clear().
+    const Entry& request(const std::string& path)
+    {
+        auto iter = m_entries.find(path);
+        if (iter != m_entries.end())
+        {
+            return iter->second.entry;
+        }
+
+        Loaded& loaded = m_entries[path];
+        if (path.empty())
+        {
+            loaded.entry.state = MeshState::failed;
+            loaded.entry.error = "no file";
+            return loaded.entry;
+        }
+
+        if (!m_pool)
+        {
+            m_pool = std::make_unique<ThreadPool>(m_threads);
+        }
+        loaded.result = m_pool->submit([path] {
+            auto result = std::make_unique<Result>();
+            result->ok = load_mesh(path, result->mesh, result->error, &result->info);
+            return result;
+        });
+        return loaded.entry;
+    }
+
+    // Uploads the meshes whose loading finished. Returns whether any entry
+    // changed state.
+    bool poll(const bool wait = false)
+    {
+        bool changed = false;
+        for (auto& [path, loaded] : m_entries)
+        {
+            if (loaded.entry.state != MeshState::loading || !loaded.result.valid())
+            {
+                continue;
+            }
+            if (!wait && loaded.result.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            {
+                continue;
+            }
+
+            const std::unique_ptr<Result> result = loaded.result.get();
+            changed = true;
+            if (!result->ok)
+            {
+                std::cerr << "[WARN] Cannot load mesh " << path << ": " << result->error << "\n";
+                loaded.entry.state = MeshState::failed;
+                loaded.entry.error = result->error;
+                continue;
+            }
+
+            upload(loaded.entry, result->mesh);
+            (result->info.from_cache ? m_stats.loads_from_cache : m_stats.loads_from_obj) += 1;
+            m_stats.load_milliseconds += result->info.milliseconds;
+        }
+        return changed;
+    }
+
+    // Destroys all meshes and forgets failed files, so they are read again
+    void clear()
+    {
+        if (m_pool)
+        {
+            // Queued loads never start, running ones finish in the background
+            // into futures that are dropped unread
+            m_pool->discard_pending();
+        }
+        for (auto& [path, loaded] : m_entries)
+        {
+            m_meshes.destroy(loaded.entry.handle);
+        }
+        m_entries.clear();
+    }
+
+    // Whether files are still loading, so a later poll() has work to do
+    bool busy() const
+    {
+        return std::any_of(m_entries.begin(), m_entries.end(),
+                           [](const auto& entry) { return entry.second.result.valid(); });
+    }
+
+    const MeshLibraryStats& stats()
+    {
+        m_stats.meshes = 0;
+        m_stats.loading = 0;
+        m_stats.triangles = 0;
+        for (const auto& [path, loaded] : m_entries)
+        {
+            m_stats.meshes += loaded.entry.state == MeshState::ready ? 1 : 0;
+            m_stats.loading += loaded.entry.state == MeshState::loading ? 1 : 0;
+            m_stats.triangles += loaded.entry.triangles;
+        }
+        return m_stats;
+    }
+
+private:
+    struct Result
+    {
+        bool         ok = false;
+        MeshData     mesh;
+        std::string  error;
+        MeshLoadInfo info;
+    };
+
+    struct Loaded
+    {
+        Entry                                entry;
+        std::future<std::unique_ptr<Result>> result;
+    };
+
+    void upload(Entry& entry, const MeshData& mesh)
+    {
+        entry.handle = m_meshes.create(mesh.vertices.data(), mesh.vertices.size() * sizeof(MeshVertex),
+                                       sizeof(MeshVertex), position_normal_uv_layout(), GL_TRIANGLES, mesh.indices);
+        entry.state = entry.handle.valid() ? MeshState::ready : MeshState::failed;
+        entry.triangles = mesh.triangles();
+
+        // The unit cube reaches sqrt(3)/2 from its center
+        const glm::vec3 low(mesh.bounds_min[0], mesh.bounds_min[1], mesh.bounds_min[2]);
+        const glm::vec3 high(mesh.bounds_max[0], mesh.bounds_max[1], mesh.bounds_max[2]);
+        const float radius = 0.5f * glm::length(high - low);
+        entry.fit = glm::vec4(0.5f * (low + high), radius > 0.f ? 0.866f / radius : 1.f);
+    }
+
+    MeshManager&                            m_meshes;
+    size_t                                  m_threads;
+    std::unique_ptr<ThreadPool>             m_pool;
+    std::unordered_map<std::string, Loaded> m_entries;
+    MeshLibraryStats                        m_stats;
+};
@@ -0,0 +1,389 @@
+#pragma once
+
+// Loads OBJ meshes into indexed vertex data for the mesh viewport node.
+// Needs no GL context, so meshes are loaded on worker threads. Parsing an OBJ
+// is slow, so the result is written next to it as "<file>.mcache": a header
+// followed by the raw vertex and index arrays, which are read back with a
+// single copy out of a memory mapping.
+//
+// Include with TINYOBJLOADER_IMPLEMENTATION defined in one translation unit.
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "3rdparty/tiny_obj_loader.h"
+
+// Same layout as Vertex in object.hpp, see position_normal_uv_layout
+struct MeshVertex
+{
+    float position[3];
+    float normal[3];
+    float uv[2];
+};
+static_assert(sizeof(MeshVertex) == 32, "MeshVertex must stay tightly packed");
+
+struct MeshData
+{
+    std::vector<MeshVertex> vertices;
+    std::vector<uint32_t>   indices;
+    float                   bounds_min[3] = {0.f, 0.f, 0.f};
+    float                   bounds_max[3] = {0.f, 0.f, 0.f};
+
+    size_t triangles() const { return indices.size() / 3; }
+};
+
+inline std::string mesh_cache_path(const std::string& path) { return path + ".mcache"; }
+
+namespace mesh_cache
+{
+inline constexpr char     magic[4] = {'M', 'E', 'M', 'C'};
+inline constexpr uint32_t version = 1;
+
+// Written in native byte order; a cache from another architecture fails
+// the version check and is rebuilt
+struct Header
+{
+    char     magic[4];
+    uint32_t version;
+    uint64_t source_size;
+    int64_t  source_time;
+    uint64_t vertex_count;
+    uint64_t index_count;
+    float    bounds_min[3];
+    float    bounds_max[3];
+};
+
+// Size and modification time of the OBJ, a cache made from another version
+// of it is stale. Both are 0 if the OBJ is missing, which keeps a shipped
+// cache usable without its source.
+inline void source_stamp(const std::string& path, uint64_t& size, int64_t& time)
+{
+    std::error_code error;
+    size = std::filesystem::file_size(path, error);
+    if (error)
+    {
+        size = 0;
+        time = 0;
+        return;
+    }
+    time = static_cast<int64_t>(std::filesystem::last_write_time(path, error).time_since_epoch().count());
+}
+
+// Read-only view of a whole file, mapped where possible
+class FileView
+{
+public:
+    explicit FileView(const std::string& path)
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            return;
+        }
+        struct stat info;
+        if (::fstat(fd, &info) == 0 && info.st_size > 0)
+        {
+            void* data = ::mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED)
+            {
+                m_mapping = data;
+                m_data = static_cast<const uint8_t*>(data);
+                m_size = static_cast<size_t>(info.st_size);
+            }
+        }
+        ::close(fd);
+#else
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (file.is_open())
+        {
+            m_buffer.resize(static_cast<size_t>(file.tellg()));
+            file.seekg(0);
+            if (file.read(reinterpret_cast<char*>(m_buffer.data()), m_buffer.size()))
+            {
+                m_data = m_buffer.data();
+                m_size = m_buffer.size();
+            }
+        }
+#endif
+    }
+
+    ~FileView()
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        if (m_mapping)
+        {
+            ::munmap(m_mapping, m_size);
+        }
+#endif
+    }
+
+    FileView(const FileView&) = delete;
+    FileView& operator=(const FileView&) = delete;
+
+    const uint8_t* data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+private:
+    const uint8_t*       m_data = nullptr;
+    size_t               m_size = 0;
+    void*                m_mapping = nullptr;
+    std::vector<uint8_t> m_buffer;
+};
+} // namespace mesh_cache
+
+// Returns false if there is no cache or it does not match the OBJ
+inline bool read_mesh_cache(const std::string& path, MeshData& mesh)
+{
+    const mesh_cache::FileView view(mesh_cache_path(path));
+    if (view.size() < sizeof(mesh_cache::Header))
+    {
+        return false;
+    }
+
+    mesh_cache::Header header;
+    std::memcpy(&header, view.data(), sizeof(header));
+    uint64_t source_size = 0;
+    int64_t source_time = 0;
+    mesh_cache::source_stamp(path, source_size, source_time);
+
+    if (std::memcmp(header.magic, mesh_cache::magic, 4) != 0 || header.version != mesh_cache::version ||
+        (source_size != 0 && (header.source_size != source_size || header.source_time != source_time)))
+    {
+        return false;
+    }
+
+    const uint64_t payload = view.size() - sizeof(header);
+    if (header.vertex_count > payload / sizeof(MeshVertex) ||
+        header.index_count > (payload - header.vertex_count * sizeof(MeshVertex)) / sizeof(uint32_t) ||
+        header.vertex_count * sizeof(MeshVertex) + header.index_count * sizeof(uint32_t) != payload)
+    {
+        return false;
+    }
+
+    const uint8_t* data = view.data() + sizeof(header);
+    mesh.vertices.resize(header.vertex_count);
+    mesh.indices.resize(header.index_count);
+    std::memcpy(mesh.vertices.data(), data, header.vertex_count * sizeof(MeshVertex));
+    std::memcpy(mesh.indices.data(), data + header.vertex_count * sizeof(MeshVertex),
+                header.index_count * sizeof(uint32_t));
+    std::copy_n(header.bounds_min, 3, mesh.bounds_min);
+    std::copy_n(header.bounds_max, 3, mesh.bounds_max);
+
+    // An index past the vertices would make the GPU read out of bounds
+    return std::all_of(mesh.indices.begin(), mesh.indices.end(),
+                       [count = header.vertex_count](const uint32_t index) { return index < count; });
+}
+
+inline bool write_mesh_cache(const std::string& path, const MeshData& mesh)
+{
+    mesh_cache::Header header = {};
+    std::memcpy(header.magic, mesh_cache::magic, 4);
+    header.version = mesh_cache::version;
+    mesh_cache::source_stamp(path, header.source_size, header.source_time);
+    header.vertex_count = mesh.vertices.size();
+    header.index_count = mesh.indices.size();
+    std::copy_n(mesh.bounds_min, 3, header.bounds_min);
+    std::copy_n(mesh.bounds_max, 3, header.bounds_max);
+
+    // Renamed into place, so a reader never sees half a cache
+    const std::string final_path = mesh_cache_path(path);
+    const std::string temporary_path = final_path + ".tmp";
+    {
+        std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+        {
+            return false;
+        }
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(mesh.vertices.data()), mesh.vertices.size() * sizeof(MeshVertex));
+        file.write(reinterpret_cast<const char*>(mesh.indices.data()), mesh.indices.size() * sizeof(uint32_t));
+        if (!file)
+        {
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporary_path, final_path, error);
+    return !error;
+}
+
+// Parses an OBJ and merges the corners that share position, normal and uv
+// into one indexed vertex. Corners without a normal get the area weighted
+// normal of their faces.
+inline bool parse_obj(const std::string& path, MeshData& mesh, std::string& error)
+{
+    tinyobj::ObjReaderConfig config;
+    config.triangulate = true;
+    config.vertex_color = false;
+
+    tinyobj::ObjReader reader;
+    if (!reader.ParseFromFile(path, config))
+    {
+        error = reader.Error().empty() ? "cannot read " + path : reader.Error();
+        while (!error.empty() && error.back() == '\n')
+        {
+            error.pop_back();
+        }
+        return false;
+    }
+
+    const tinyobj::attrib_t& attrib = reader.GetAttrib();
+    mesh = MeshData();
+
+    struct CornerHash
+    {
+        size_t operator()(const std::array<int, 3>& key) const
+        {
+            return (static_cast<size_t>(key[0]) * 73856093u) ^ (static_cast<size_t>(key[1]) * 19349663u) ^
+                   (static_cast<size_t>(key[2]) * 83492791u);
+        }
+    };
+    std::unordered_map<std::array<int, 3>, uint32_t, CornerHash> vertex_of_corner;
+    vertex_of_corner.reserve(attrib.vertices.size() / 3);
+
+    bool missing_normals = false;
+    for (const tinyobj::shape_t& shape : reader.GetShapes())
+    {
+        for (const tinyobj::index_t& corner : shape.mesh.indices)
+        {
+            const std::array<int, 3> key = {corner.vertex_index, corner.normal_index, corner.texcoord_index};
+            auto [iter, inserted] = vertex_of_corner.try_emplace(key, static_cast<uint32_t>(mesh.vertices.size()));
+            if (inserted)
+            {
+                MeshVertex vertex = {};
+                for (int i = 0; i < 3; ++i)
+                {
+                    vertex.position[i] = attrib.vertices[3 * corner.vertex_index + i];
+                }
+                if (corner.normal_index >= 0)
+                {
+                    for (int i = 0; i < 3; ++i)
+                    {
+                        vertex.normal[i] = attrib.normals[3 * corner.normal_index + i];
+                    }
+                }
+                else
+                {
+                    missing_normals = true;
+                }
+                if (corner.texcoord_index >= 0)
+                {
+                    vertex.uv[0] = attrib.texcoords[2 * corner.texcoord_index];
+                    vertex.uv[1] = attrib.texcoords[2 * corner.texcoord_index + 1];
+                }
+                mesh.vertices.push_back(vertex);
+            }
+            mesh.indices.push_back(iter->second);
+        }
+    }
+
+    if (mesh.indices.empty())
+    {
+        error = path + " has no faces";
+        return false;
+    }
+
+    if (missing_normals)
+    {
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+        {
+            MeshVertex* corners[3] = {&mesh.vertices[mesh.indices[i]], &mesh.vertices[mesh.indices[i + 1]],
+                                      &mesh.vertices[mesh.indices[i + 2]]};
+            float a[3], b[3];
+            for (int k = 0; k < 3; ++k)
+            {
+                a[k] = corners[1]->position[k] - corners[0]->position[k];
+                b[k] = corners[2]->position[k] - corners[0]->position[k];
+            }
+            const float normal[3] = {a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0]};
+            for (MeshVertex* corner : corners)
+            {
+                for (int k = 0; k < 3; ++k)
+                {
+                    corner->normal[k] += normal[k];
+                }
+            }
+        }
+        for (MeshVertex& vertex : mesh.vertices)
+        {
+            const float length = std::sqrt(vertex.normal[0] * vertex.normal[0] + vertex.normal[1] * vertex.normal[1] +
+                                           vertex.normal[2] * vertex.normal[2]);
+            if (length > 0.f)
+            {
+                for (float& component : vertex.normal)
+                {
+                    component /= length;
+                }
+            }
+        }
+    }
+
+    std::copy_n(mesh.vertices[0].position, 3, mesh.bounds_min);
+    std::copy_n(mesh.vertices[0].position, 3, mesh.bounds_max);
+    for (const MeshVertex& vertex : mesh.vertices)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            mesh.bounds_min[k] = std::min(mesh.bounds_min[k], vertex.position[k]);
+            mesh.bounds_max[k] = std::max(mesh.bounds_max[k], vertex.position[k]);
+        }
+    }
+
+    return true;
+}
+
+struct MeshLoadInfo
+{
+    bool   from_cache = false;
+    bool   cache_written = false;
+    double milliseconds = 0.0;
+};
+
+// Reads the cache of path if it is current, otherwise parses the OBJ and
+// writes the cache. A cache that cannot be written (read-only folder) only
+// costs the next load the parsing again.
+inline bool load_mesh(const std::string& path, MeshData& mesh, std::string& error, MeshLoadInfo* info = nullptr)
+{
+    const auto start = std::chrono::steady_clock::now();
+    MeshLoadInfo result;
+
+    result.from_cache = read_mesh_cache(path, mesh);
+    if (!result.from_cache)
+    {
+        if (!parse_obj(path, mesh, error))
+        {
+            return false;
+        }
+        result.cache_written = write_mesh_cache(path, mesh);
+        if (!result.cache_written)
+        {
+            std::cerr << "[WARN] Cannot write mesh cache " << mesh_cache_path(path) << "\n";
+        }
+    }
+
+    result.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    if (info)
+    {
+        *info = result;
+    }
+    return true;
+}
@@ -0,0 +1,275 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <GL/glew.h>
+
+#include "gl_state.hpp"
+
+// A float vertex attribute of an interleaved vertex buffer, offset in bytes.
+struct VertexAttribute
+{
+    GLuint index;
+    GLint  components;
+    size_t offset;
+};
+
+// Position, normal and uv, the layout of Vertex and CubeVertices.
+inline std::vector<VertexAttribute> position_normal_uv_layout()
+{
+    return {{0, 3, 0}, {1, 3, 3 * sizeof(float)}, {2, 2, 6 * sizeof(float)}};
+}
+
+// Refers to a mesh of a MeshManager. A handle whose mesh was destroyed stays
+// invalid even when its slot is reused.
+struct MeshHandle
+{
+    uint32_t index = 0;
+    uint32_t generation = 0;
+
+    bool valid() const { return generation != 0; }
+};
+
+struct MeshStats
+{
+    size_t   live_meshes = 0;
+    size_t   live_vertex_arrays = 0;
+    size_t   live_buffers = 0;
+    size_t   gpu_bytes = 0;
+    // Totals since the manager was created. Comparing them between frames
+    // shows whether anything is created while drawing.
+    uint64_t buffers_created = 0;
+    uint64_t buffers_deleted = 0;
+};
+
+// Owns the vertex arrays and buffers of all meshes. Meshes are uploaded once
+// by create() and only drawn afterwards; everything is deleted by destroy()
+// or at the latest with the manager, which needs the GL context to be current.
+class MeshManager
+{
+public:
+    MeshManager() = default;
+    ~MeshManager() { clear(); }
+
+    MeshManager(const MeshManager&) = delete;
+    MeshManager& operator=(const MeshManager&) = delete;
+
+    // Uploads interleaved vertices and optional 32 bit indices. count is the
+    // number of indices, or of vertices for a mesh without indices.
+    MeshHandle create(const void* vertices, size_t vertex_bytes, GLsizei stride,
+                      const std::vector<VertexAttribute>& layout, GLenum mode,
+                      const std::vector<unsigned int>& indices = {})
+    {
+        Mesh mesh;
+        mesh.mode = mode;
+        mesh.count = indices.empty() ? static_cast<GLsizei>(vertex_bytes / stride)
+                                     : static_cast<GLsizei>(indices.size());
+        mesh.bytes = vertex_bytes + indices.size() * sizeof(unsigned int);
+
+        glGenVertexArrays(1, &mesh.vao);
+        GlState::instance().bind_vertex_array(mesh.vao);
+
+        glGenBuffers(1, &mesh.vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+        glBufferData(GL_ARRAY_BUFFER, vertex_bytes, vertices, GL_STATIC_DRAW);
+        m_stats.buffers_created += 1;
+
+        if (!indices.empty())
+        {
+            // Element buffer binding is VAO state, so it stays bound with the VAO
+            glGenBuffers(1, &mesh.ebo);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(),
+                         GL_STATIC_DRAW);
+            m_stats.buffers_created += 1;
+        }
+
+        for (const VertexAttribute& attribute : layout)
+        {
+            glVertexAttribPointer(attribute.index, attribute.components, GL_FLOAT, GL_FALSE, stride,
+                                  (void*)attribute.offset);
+            glEnableVertexAttribArray(attribute.index);
+        }
+
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        m_stats.live_meshes += 1;
+        m_stats.live_vertex_arrays += 1;
+        m_stats.live_buffers += mesh.ebo ? 2 : 1;
+        m_stats.gpu_bytes += mesh.bytes;
+
+        uint32_t index;
+        if (!m_free.empty())
+        {
+            index = m_free.back();
+            m_free.pop_back();
+            mesh.generation = m_meshes[index].generation + 1;
+            m_meshes[index] = mesh;
+        }
+        else
+        {
+            index = static_cast<uint32_t>(m_meshes.size());
+            mesh.generation = 1;
+            m_meshes.push_back(mesh);
+        }
+
+        return {index, mesh.generation};
+    }
+
+    bool alive(const MeshHandle handle) const
+    {
+        return handle.valid() && handle.index < m_meshes.size() && m_meshes[handle.index].vao != 0 &&
+               m_meshes[handle.index].generation == handle.generation;
+    }
+
+    // Draws with whatever program is in use. Invalid handles draw nothing.
+    void draw(const MeshHandle handle) const
+    {
+        if (!alive(handle))
+        {
+            return;
+        }
+
+        // The vertex array stays bound, the next draw of the mesh binds nothing
+        const Mesh& mesh = m_meshes[handle.index];
+        GlState::instance().bind_vertex_array(mesh.vao);
+        if (mesh.ebo)
+        {
+            glDrawElements(mesh.mode, mesh.count, GL_UNSIGNED_INT, nullptr);
+        }
+        else
+        {
+            glDrawArrays(mesh.mode, 0, mesh.count);
+        }
+    }
+
+    // Draws instances copies, reading the attributes set up by
+    // attach_instance_attributes once per instance
+    void draw_instanced(const MeshHandle handle, const GLsizei instances) const
+    {
+        if (!alive(handle) || instances <= 0)
+        {
+            return;
+        }
+
+        // The vertex array stays bound, the next draw of the mesh binds nothing
+        const Mesh& mesh = m_meshes[handle.index];
+        GlState::instance().bind_vertex_array(mesh.vao);
+        if (mesh.ebo)
+        {
+            glDrawElementsInstanced(mesh.mode, mesh.count, GL_UNSIGNED_INT, nullptr, instances);
+        }
+        else
+        {
+            glDrawArraysInstanced(mesh.mode, 0, mesh.count, instances);
+        }
+    }
+
+    // Points per-instance attributes of the mesh at buffer, which stays owned
+    // by the caller. Offsets are relative to base_offset, so the same buffer
+    // can hold the instances of several meshes.
+    void attach_instance_attributes(const MeshHandle handle, const GLuint buffer, const GLsizei stride,
+                                    const std::vector<VertexAttribute>& layout, const size_t base_offset = 0)
+    {
+        if (!alive(handle))
+        {
+            return;
+        }
+
+        GlState::instance().bind_vertex_array(m_meshes[handle.index].vao);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        for (const VertexAttribute& attribute : layout)
+        {
+            glVertexAttribPointer(attribute.index, attribute.components, GL_FLOAT, GL_FALSE, stride,
+                                  (void*)(base_offset + attribute.offset));
+            glEnableVertexAttribArray(attribute.index);
+            glVertexAttribDivisor(attribute.index, 1);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // Turns the attributes of attach_instance_attributes off again, so plain
+    // draws of the mesh do not read the instance buffer
+    void detach_instance_attributes(const MeshHandle handle, const std::vector<VertexAttribute>& layout)
+    {
+        if (!alive(handle))
+        {
+            return;
+        }
+
+        GlState::instance().bind_vertex_array(m_meshes[handle.index].vao);
+        for (const VertexAttribute& attribute : layout)
+        {
+            glDisableVertexAttribArray(attribute.index);
+            glVertexAttribDivisor(attribute.index, 0);
+        }
+    }
+
+    void destroy(MeshHandle& handle)
+    {
+        if (!alive(handle))
+        {
+            handle = MeshHandle();
+            return;
+        }
+
+        release(m_meshes[handle.index]);
+        m_free.push_back(handle.index);
+        handle = MeshHandle();
+    }
+
+    // Slots are kept, so handles to the cleared meshes stay invalid
+    void clear()
+    {
+        m_free.clear();
+        for (uint32_t i = 0; i < m_meshes.size(); ++i)
+        {
+            if (m_meshes[i].vao != 0)
+            {
+                release(m_meshes[i]);
+            }
+            m_free.push_back(i);
+        }
+    }
+
+    const MeshStats& stats() const { return m_stats; }
+
+private:
+    struct Mesh
+    {
+        GLuint   vao = 0;
+        GLuint   vbo = 0;
+        GLuint   ebo = 0;
+        GLenum   mode = GL_TRIANGLES;
+        GLsizei  count = 0;
+        size_t   bytes = 0;
+        uint32_t generation = 0;
+    };
+
+    void release(Mesh& mesh)
+    {
+        GlState::instance().deleted_vertex_array(mesh.vao);
+        glDeleteVertexArrays(1, &mesh.vao);
+        glDeleteBuffers(1, &mesh.vbo);
+        m_stats.buffers_deleted += 1;
+        m_stats.live_buffers -= 1;
+        if (mesh.ebo)
+        {
+            glDeleteBuffers(1, &mesh.ebo);
+            m_stats.buffers_deleted += 1;
+            m_stats.live_buffers -= 1;
+        }
+
+        m_stats.live_meshes -= 1;
+        m_stats.live_vertex_arrays -= 1;
+        m_stats.gpu_bytes -= mesh.bytes;
+
+        const uint32_t generation = mesh.generation;
+        mesh = Mesh();
+        mesh.generation = generation;
+    }
+
+    std::vector<Mesh>     m_meshes;
+    std::vector<uint32_t> m_free;
+    MeshStats             m_stats;
+};
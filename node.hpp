@@ -14,7 +14,9 @@ enum class NodeType
     value,
     power,
     cubeviewport,
-    spherevieport
+    spherevieport,
+    meshviewport,
+    texture
 };
 
 struct Node
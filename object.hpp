@@ -1,5 +1,7 @@
 #pragma once
 
+#include "frame_uniforms.hpp"
+
 float CubeVertices[] = {
     // Position          // Normals         // Texture coordinations
     -0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f,  0.0f,
@@ -44,11 +46,6 @@ float CubeVertices[] = {
     -0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  0.0f,  1.0f,
     -0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f,  0.0f
 };
-unsigned int CubeIndices[] = {
-    0, 1, 3, // first triangle
-    1, 2, 3  // second triangle
-};
-
 #include <vector>
 #include <cmath>
 
@@ -92,14 +89,58 @@ std::vector<Vertex> generateSphere(float radius, int latitudeSegments, int longi
     return vertices;
 }
 
+// Triangle list over the grid of generateSphere. The first and last row
+// collapse into the poles, so they get one triangle per segment instead of two.
+std::vector<unsigned int> generateSphereIndices(int latitudeSegments, int longitudeSegments) {
+    std::vector<unsigned int> indices;
+    indices.reserve(static_cast<size_t>(latitudeSegments - 1) * longitudeSegments * 6);
+
+    const unsigned int rowLength = longitudeSegments + 1;
+    for (int lat = 0; lat < latitudeSegments; ++lat) {
+        for (int lon = 0; lon < longitudeSegments; ++lon) {
+            const unsigned int top = lat * rowLength + lon;
+            const unsigned int bottom = top + rowLength;
+
+            if (lat != 0) {
+                indices.insert(indices.end(), {top, top + 1, bottom});
+            }
+            if (lat != latitudeSegments - 1) {
+                indices.insert(indices.end(), {top + 1, bottom + 1, bottom});
+            }
+        }
+    }
+
+    return indices;
+}
+
+struct SphereLod {
+    int latitudeSegments;
+    int longitudeSegments;
+};
+
+// From coarse to fine, each level has about four times the triangles
+constexpr SphereLod SphereLods[] = {{6, 12}, {12, 24}, {24, 48}, {48, 96}};
+constexpr int SphereLodCount = sizeof(SphereLods) / sizeof(SphereLods[0]);
+
+// The coarsest level whose edges along the equator stay below about ten
+// pixels when the sphere is about diameterPixels wide on screen
+inline int sphereLodForPixels(float diameterPixels) {
+    const float segments = float(M_PI) * diameterPixels / 10.0f;
+    for (int lod = 0; lod < SphereLodCount; ++lod) {
+        if (SphereLods[lod].longitudeSegments >= segments) {
+            return lod;
+        }
+    }
+    return SphereLodCount - 1;
+}
+
 
 
 const char* shaderVertex =
 "#version 330 core\n"
 "layout(location = 0) in vec3 aPos;\n"
+FRAME_DATA_GLSL
 "uniform mat4 model;\n"
-"uniform mat4 view;\n"
-"uniform mat4 projection;\n"
 "void main()\n"
 "{\n"
 "    gl_Position = projection * view * model * vec4(aPos, 1.0);\n"
@@ -108,10 +149,75 @@ const char* shaderVertex =
 const char* shaderFragment =
 "#version 330 core\n"
 "out vec4 FragColor;\n"
+FRAME_DATA_GLSL
 "uniform vec3 color;\n"
 "void main()\n"
 "{\n"
 "    FragColor = vec4(color, 1.0);\n"
 "}\n";
 
+// Drawn with shaderVertex while the preview program compiles: the color
+// washed out towards gray under diagonal stripes, so it is not mistaken for
+// the material
+const char* shaderPlaceholderFragment =
+"#version 330 core\n"
+"out vec4 FragColor;\n"
+"uniform vec3 color;\n"
+"void main()\n"
+"{\n"
+"    float stripe = step(0.5, fract((gl_FragCoord.x + gl_FragCoord.y) / 16.0));\n"
+"    FragColor = vec4(mix(vec3(0.4), color, 0.35) * (0.7 + 0.3 * stripe), 1.0);\n"
+"}\n";
+
 
+// Instanced previews for the thumbnail atlas. Every instance is drawn into
+// its own cell of the atlas, cell holds the offset and scale from the cell's
+// clip space to the atlas. The clip distances keep a preview inside its cell.
+const char* shaderThumbnailVertex =
+"#version 330 core\n"
+"layout(location = 0) in vec3 aPos;\n"
+"layout(location = 3) in vec4 cell;\n"
+"layout(location = 4) in vec3 instanceColor;\n"
+"layout(location = 5) in vec2 rotation;\n"
+"layout(location = 6) in vec4 fit;\n"
+FRAME_DATA_GLSL
+"uniform int background;\n"
+"uniform vec3 backgroundColor;\n"
+"out vec3 vertexColor;\n"
+"out float gl_ClipDistance[4];\n"
+"mat4 rotateX(float a)\n"
+"{\n"
+"    return mat4(1.0, 0.0, 0.0, 0.0,  0.0, cos(a), sin(a), 0.0,  0.0, -sin(a), cos(a), 0.0,  0.0, 0.0, 0.0, 1.0);\n"
+"}\n"
+"mat4 rotateY(float a)\n"
+"{\n"
+"    return mat4(cos(a), 0.0, -sin(a), 0.0,  0.0, 1.0, 0.0, 0.0,  sin(a), 0.0, cos(a), 0.0,  0.0, 0.0, 0.0, 1.0);\n"
+"}\n"
+"void main()\n"
+"{\n"
+"    vec4 clip;\n"
+"    if (background != 0)\n"
+"    {\n"
+"        clip = vec4(aPos.xy, 1.0, 1.0);\n"
+"        vertexColor = backgroundColor;\n"
+"    }\n"
+"    else\n"
+"    {\n"
+"        clip = projection * view * rotateY(rotation.y) * rotateX(rotation.x) * vec4((aPos - fit.xyz) * fit.w, 1.0);\n"
+"        vertexColor = instanceColor;\n"
+"    }\n"
+"    gl_ClipDistance[0] = clip.w + clip.x;\n"
+"    gl_ClipDistance[1] = clip.w - clip.x;\n"
+"    gl_ClipDistance[2] = clip.w + clip.y;\n"
+"    gl_ClipDistance[3] = clip.w - clip.y;\n"
+"    gl_Position = vec4(clip.xy * cell.zw + cell.xy * clip.w, clip.z, clip.w);\n"
+"}\n";
+
+const char* shaderThumbnailFragment =
+"#version 330 core\n"
+"in vec3 vertexColor;\n"
+"out vec4 FragColor;\n"
+"void main()\n"
+"{\n"
+"    FragColor = vec4(vertexColor, 1.0);\n"
+"}\n";
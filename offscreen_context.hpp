@@ -0,0 +1,164 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <GL/glew.h>
+
+#include "gl_state.hpp"
+
+#ifdef MATERIALEDITOR_HAVE_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+// A GL 3.3 core context without any window or surface, rendering only into
+// framebuffer objects. Uses EGL with the Mesa surfaceless platform when it is
+// available, so it runs on llvmpipe in containers without a display or GPU.
+// FrameBuffer, Shader and the preview renderers work in it unchanged, which
+// is what --bake and --bench-previews build on.
+class OffscreenContext
+{
+public:
+    OffscreenContext() = default;
+    ~OffscreenContext() { destroy(); }
+
+    OffscreenContext(const OffscreenContext&) = delete;
+    OffscreenContext& operator=(const OffscreenContext&) = delete;
+
+    bool create()
+    {
+#ifdef MATERIALEDITOR_HAVE_EGL
+        if (!open_display())
+        {
+            std::cerr << "Failed to initialize EGL!" << std::endl;
+            return false;
+        }
+
+        if (!eglBindAPI(EGL_OPENGL_API))
+        {
+            std::cerr << "EGL has no desktop OpenGL support!" << std::endl;
+            destroy();
+            return false;
+        }
+
+        const EGLint configAttributes[] = {
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_NONE
+        };
+        EGLConfig config = EGL_NO_CONFIG_KHR;
+        EGLint numConfigs = 0;
+        eglChooseConfig(m_display, configAttributes, &config, 1, &numConfigs);
+        if (numConfigs == 0)
+        {
+            // Fine with EGL_KHR_no_config_context, which Mesa implements
+            config = EGL_NO_CONFIG_KHR;
+        }
+
+        const EGLint contextAttributes[] = {
+            EGL_CONTEXT_MAJOR_VERSION, 3,
+            EGL_CONTEXT_MINOR_VERSION, 3,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE
+        };
+        m_context = eglCreateContext(m_display, config, EGL_NO_CONTEXT, contextAttributes);
+        if (m_context == EGL_NO_CONTEXT ||
+            !eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, m_context))
+        {
+            std::cerr << "Failed to create a surfaceless EGL context!" << std::endl;
+            destroy();
+            return false;
+        }
+
+        // GLEW looks for GLX as well, which is missing without a display
+        glewExperimental = GL_TRUE;
+        const GLenum status = glewInit();
+        if (status != GLEW_OK && status != GLEW_ERROR_NO_GLX_DISPLAY)
+        {
+            std::cerr << "Failed to initialize GLEW!" << std::endl;
+            destroy();
+            return false;
+        }
+        // A new context starts with default state, not what was cached
+        GlState::instance().invalidate();
+
+        const GLubyte* renderer = glGetString(GL_RENDERER);
+        m_renderer = renderer ? reinterpret_cast<const char*>(renderer) : "";
+        std::cerr << "[INFO] Offscreen context: " << m_renderer << std::endl;
+        return true;
+#else
+        std::cerr << "Offscreen rendering needs EGL, which was not found at build time." << std::endl;
+        return false;
+#endif
+    }
+
+    void destroy()
+    {
+#ifdef MATERIALEDITOR_HAVE_EGL
+        if (m_display != EGL_NO_DISPLAY)
+        {
+            eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+            if (m_context != EGL_NO_CONTEXT)
+            {
+                eglDestroyContext(m_display, m_context);
+            }
+            eglTerminate(m_display);
+        }
+        m_display = EGL_NO_DISPLAY;
+        m_context = EGL_NO_CONTEXT;
+#endif
+    }
+
+    // GL_RENDERER of the created context, e.g. "llvmpipe (LLVM 15.0.6, 256 bits)"
+    const std::string& renderer() const { return m_renderer; }
+
+private:
+#ifdef MATERIALEDITOR_HAVE_EGL
+    // Mesa's surfaceless platform first, which runs on llvmpipe without any
+    // GPU. Drivers without it (NVIDIA) expose their GPUs as EGL devices,
+    // and the default display is the last resort.
+    bool open_display()
+    {
+        auto getPlatformDisplay =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (getPlatformDisplay && initialize(getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY,
+                                                                nullptr)))
+        {
+            return true;
+        }
+
+        auto queryDevices = (PFNEGLQUERYDEVICESEXTPROC)eglGetProcAddress("eglQueryDevicesEXT");
+        if (getPlatformDisplay && queryDevices)
+        {
+            EGLDeviceEXT devices[8];
+            EGLint count = 0;
+            if (queryDevices(8, devices, &count))
+            {
+                for (EGLint i = 0; i < count; ++i)
+                {
+                    if (initialize(getPlatformDisplay(EGL_PLATFORM_DEVICE_EXT, devices[i], nullptr)))
+                    {
+                        return true;
+                    }
+                }
+            }
+        }
+
+        return initialize(eglGetDisplay(EGL_DEFAULT_DISPLAY));
+    }
+
+    bool initialize(const EGLDisplay display)
+    {
+        EGLint major = 0, minor = 0;
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+        {
+            return false;
+        }
+        m_display = display;
+        return true;
+    }
+
+    EGLDisplay m_display = EGL_NO_DISPLAY;
+    EGLContext m_context = EGL_NO_CONTEXT;
+#endif
+    std::string m_renderer;
+};
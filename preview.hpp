@@ -0,0 +1,375 @@
+#pragma once
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+
+#include "object.hpp"
+#include "shader.hpp"
+#include "mesh_manager.hpp"
+#include "frame_uniforms.hpp"
+#include "gl_state.hpp"
+
+enum class PreviewShape
+{
+    cube,
+    sphere,
+    mesh
+};
+
+// Everything a preview image depends on. A cached preview only needs to be
+// drawn again when its key changes. Frame time is not part of it because the
+// preview shaders do not read it.
+struct PreviewKey
+{
+    PreviewShape shape = PreviewShape::cube;
+    glm::vec3    color = glm::vec3(-1.0f);
+    float        rotationX = 0.f;
+    float        rotationY = 0.f;
+    int          width = 0;
+    int          height = 0;
+    // PreviewRenderer::revision() when drawn
+    uint64_t     revision = 0;
+    // Sphere level of detail, see SphereLods
+    int          lod = 0;
+    // Mesh of a mesh preview and the transform that fits it into view,
+    // center in xyz and scale in w, see MeshLibrary
+    MeshHandle   mesh;
+    glm::vec4    fit = glm::vec4(0.f, 0.f, 0.f, 1.f);
+
+    bool operator==(const PreviewKey& other) const
+    {
+        return shape == other.shape && color == other.color && rotationX == other.rotationX &&
+               rotationY == other.rotationY && width == other.width && height == other.height &&
+               revision == other.revision && lod == other.lod && mesh.index == other.mesh.index &&
+               mesh.generation == other.mesh.generation && fit == other.fit;
+    }
+    bool operator!=(const PreviewKey& other) const { return !(*this == other); }
+};
+
+// Draws the cube, sphere and mesh material previews into the currently bound
+// framebuffer. Needs a current GL context when constructed.
+class PreviewRenderer
+{
+public:
+    PreviewRenderer()
+    {
+        m_cube = m_meshes.create(CubeVertices, sizeof(CubeVertices), 8 * sizeof(float),
+                                 position_normal_uv_layout(), GL_TRIANGLES);
+        setupSphere(1.0f);
+
+        // Small enough to link right away, the cache usually has it
+        m_placeholder.loadShader(shaderVertex, TypeShader::VERTEX_SHADER);
+        m_placeholder.loadShader(shaderPlaceholderFragment, TypeShader::FRAGMENT_SHADER);
+        m_placeholder.createShaderProgram();
+        m_placeholderModelLocation = m_placeholder.uniformLocation("model");
+        m_placeholderColorLocation = m_placeholder.uniformLocation("color");
+
+        set_shader_sources(shaderVertex, shaderFragment);
+    }
+
+private:
+    MeshManager m_meshes;
+    MeshHandle  m_cube;
+    MeshHandle  m_sphere[SphereLodCount];
+    // The program previews are drawn with, null until the first one linked
+    std::unique_ptr<Shader> mainShader;
+    // Compiling in the background, replaces mainShader once linked
+    std::unique_ptr<Shader> m_pendingShader;
+    // Draws until the first program linked
+    Shader m_placeholder;
+    FrameUniformBuffer m_frame;
+    float m_time = 0.f;
+    uint64_t m_revision = 1;
+    uint64_t m_renders = 0;
+    // Resolved once after linking
+    GLint m_modelLocation = -1;
+    GLint m_colorLocation = -1;
+    GLint m_placeholderModelLocation = -1;
+    GLint m_placeholderColorLocation = -1;
+
+public:
+
+    const MeshStats& mesh_stats() const { return m_meshes.stats(); }
+    // For renderers that draw the preview meshes themselves
+    MeshManager& meshes() { return m_meshes; }
+    MeshHandle cube_mesh() const { return m_cube; }
+    MeshHandle sphere_mesh(int lod) const { return m_sphere[std::clamp(lod, 0, SphereLodCount - 1)]; }
+    uint64_t frame_uploads() const { return m_frame.uploads(); }
+    // Total render_to_framebuffer_* calls
+    uint64_t renders() const { return m_renders; }
+    // Changes whenever a preview mesh or the program is replaced
+    uint64_t revision() const { return m_revision; }
+    // Whether a new program is still compiling, begin_frame() switches to it
+    bool compiling() const { return m_pendingShader != nullptr; }
+
+    PreviewKey cube_key(glm::vec3 color, float rotationX, float rotationY, int width = 800, int height = 600) const
+    {
+        return {PreviewShape::cube, color, rotationX, rotationY, width, height, m_revision, 0, MeshHandle(),
+                glm::vec4(0.f, 0.f, 0.f, 1.f)};
+    }
+
+    // displayHeight is the height the preview is shown at, if it differs
+    // from the render size
+    PreviewKey sphere_key(glm::vec3 color, int width = 800, int height = 600, int displayHeight = 0) const
+    {
+        return {PreviewShape::sphere, color, 0.f, 0.f, width, height, m_revision,
+                sphere_lod(displayHeight > 0 ? displayHeight : height), MeshHandle(),
+                glm::vec4(0.f, 0.f, 0.f, 1.f)};
+    }
+
+    // An invalid mesh, one that is still loading, shows the background
+    PreviewKey mesh_key(glm::vec3 color, float rotationX, float rotationY, MeshHandle mesh, glm::vec4 fit,
+                        int width = 800, int height = 600) const
+    {
+        PreviewKey key = cube_key(color, rotationX, rotationY, width, height);
+        key.shape = PreviewShape::mesh;
+        key.mesh = mesh;
+        key.fit = fit;
+        return key;
+    }
+
+    // The mesh key is drawn with, spheres at the level of detail of the key
+    MeshHandle mesh_of(const PreviewKey& key) const
+    {
+        switch (key.shape)
+        {
+        case PreviewShape::cube:
+            return m_cube;
+        case PreviewShape::sphere:
+            return sphere_mesh(key.lod);
+        default:
+            return key.mesh;
+        }
+    }
+
+    // The camera sees the unit sphere about 0.46 viewport heights wide
+    static int sphere_lod(int pixelHeight) { return sphereLodForPixels(0.46f * float(pixelHeight)); }
+
+    // Draws the preview of key into target unless cached already holds it.
+    // Returns whether anything was drawn.
+    template <typename Target>
+    bool render_if_changed(Target& target, PreviewKey& cached, const PreviewKey& key)
+    {
+        if (cached == key)
+        {
+            return false;
+        }
+
+        target.Bind();
+        render(key);
+        target.Unbind();
+
+        cached = key;
+        return true;
+    }
+
+    // Draws the preview of key into the bound framebuffer
+    void render(const PreviewKey& key)
+    {
+        if (key.shape == PreviewShape::cube)
+        {
+            render_to_framebuffer_cube(key.color, key.rotationX, key.rotationY, key.width, key.height);
+        }
+        else if (key.shape == PreviewShape::sphere)
+        {
+            render_to_framebuffer_sphere(key.color, key.width, key.height, key.lod);
+        }
+        else
+        {
+            render_to_framebuffer_mesh(key.color, key.rotationX, key.rotationY, key.mesh, key.fit, key.width,
+                                       key.height);
+        }
+    }
+
+    // Draws key with the placeholder program into its width and height at
+    // x, y of the bound framebuffer, for previews that wait for another
+    // program. Leaves the rest of the framebuffer alone.
+    void render_placeholder(const PreviewKey& key, int x, int y)
+    {
+        m_renders += 1;
+        GlState& state = GlState::instance();
+        state.viewport(x, y, key.width, key.height);
+        state.enable(GL_DEPTH_TEST);
+        glScissor(x, y, key.width, key.height);
+        state.enable(GL_SCISSOR_TEST);
+
+        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        set_frame(key.width, key.height);
+        const glm::mat4 model = key.shape == PreviewShape::sphere
+                                    ? glm::mat4(1.0f)
+                                    : preview_model(key.rotationX, key.rotationY, key.fit);
+        use_program(m_placeholder, m_placeholderModelLocation, m_placeholderColorLocation, model, key.color);
+        m_meshes.draw(mesh_of(key));
+
+        state.disable(GL_SCISSOR_TEST);
+    }
+
+    // Call once per frame before the previews are drawn
+    void begin_frame(float time)
+    {
+        m_time = time;
+        update_program();
+    }
+
+    // Starts compiling a new preview program. Previews keep the current one,
+    // or are drawn with the placeholder program if there is none yet, until
+    // it has linked. A program that fails to link is dropped.
+    void set_shader_sources(const char* vertex, const char* fragment)
+    {
+        m_pendingShader = std::make_unique<Shader>();
+        m_pendingShader->loadShader(vertex, TypeShader::VERTEX_SHADER);
+        m_pendingShader->loadShader(fragment, TypeShader::FRAGMENT_SHADER);
+        m_pendingShader->createShaderProgramAsync();
+        update_program();
+    }
+
+    // Switches to the pending program if it is ready. Returns whether
+    // previews can be drawn with a real program.
+    bool update_program()
+    {
+        if (m_pendingShader && m_pendingShader->isReady())
+        {
+            mainShader = std::move(m_pendingShader);
+            m_modelLocation = mainShader->uniformLocation("model");
+            m_colorLocation = mainShader->uniformLocation("color");
+            // Previews drawn with the placeholder or the old program are stale
+            m_revision += 1;
+        }
+        else if (m_pendingShader && m_pendingShader->isFailed())
+        {
+            std::cerr << "[WARN] Preview program failed to link, keeping the previous one\n";
+            m_pendingShader.reset();
+        }
+        return mainShader != nullptr;
+    }
+
+    // For tools that render a single frame and cannot show placeholders
+    bool wait_for_program()
+    {
+        if (m_pendingShader)
+        {
+            m_pendingShader->waitReady();
+        }
+        return update_program();
+    }
+
+    // Camera and viewport of the following draws. The buffer is only written
+    // when they differ from the last draw, in practice once per frame.
+    void set_frame(int width, int height)
+    {
+        FrameData data;
+        data.projection = glm::perspective(glm::radians(45.0f), float(width) / float(height), 0.1f, 100.0f);
+        data.view = glm::lookAt(glm::vec3(3.0f, 3.0f, 3.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        data.time = m_time;
+        data.padding = 0.f;
+        data.viewport_size = glm::vec2(width, height);
+        m_frame.update(data);
+        m_frame.bind();
+    }
+
+    // Rotation about y, then x, of a mesh moved and scaled by fit, see
+    // PreviewKey::fit
+    static glm::mat4 preview_model(float rotationX, float rotationY, glm::vec4 fit = glm::vec4(0.f, 0.f, 0.f, 1.f))
+    {
+        glm::mat4 model = glm::mat4(1.0f);
+        model = glm::rotate(model, rotationY, glm::vec3(0.0f, 1.0f, 0.0f));
+        model = glm::rotate(model, rotationX, glm::vec3(1.0f, 0.0f, 0.0f));
+        model = glm::scale(model, glm::vec3(fit.w));
+        return glm::translate(model, -glm::vec3(fit));
+    }
+
+    // Binds the preview program, the placeholder while there is none
+    void use_program(const glm::mat4& model, const glm::vec3& color)
+    {
+        if (mainShader)
+        {
+            use_program(*mainShader, m_modelLocation, m_colorLocation, model, color);
+        }
+        else
+        {
+            use_program(m_placeholder, m_placeholderModelLocation, m_placeholderColorLocation, model, color);
+        }
+    }
+
+    void renderCube(const glm::vec3& color, const glm::mat4& model) {
+        use_program(model, color);
+        m_meshes.draw(m_cube);
+    }
+
+    // Uploads all levels of detail at once, switching between them is free
+    void setupSphere(float radius) {
+        for (int lod = 0; lod < SphereLodCount; ++lod) {
+            const SphereLod& level = SphereLods[lod];
+            auto vertices = generateSphere(radius, level.latitudeSegments, level.longitudeSegments);
+            auto indices = generateSphereIndices(level.latitudeSegments, level.longitudeSegments);
+
+            m_meshes.destroy(m_sphere[lod]);
+            m_sphere[lod] = m_meshes.create(vertices.data(), vertices.size() * sizeof(Vertex), sizeof(Vertex),
+                                            position_normal_uv_layout(), GL_TRIANGLES, indices);
+        }
+        m_revision += 1;
+    }
+
+    void renderSphere(const glm::mat4& model, const glm::vec3& color, int lod = SphereLodCount - 1) {
+        use_program(model, color);
+        m_meshes.draw(m_sphere[std::clamp(lod, 0, SphereLodCount - 1)]);
+    }
+
+    void render_to_framebuffer_cube(glm::vec3 color, float rotationX, float rotationY, int width = 800, int height = 600)
+    {
+        m_renders += 1;
+        GlState::instance().viewport(0, 0, width, height);
+        GlState::instance().enable(GL_DEPTH_TEST);
+
+        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        set_frame(width, height);
+        renderCube(color, preview_model(rotationX, rotationY));
+    }
+
+    // lod -1 picks the level from the height
+    void render_to_framebuffer_sphere(glm::vec3 color, int width = 800, int height = 600, int lod = -1) {
+
+        m_renders += 1;
+        GlState::instance().viewport(0, 0, width, height);
+        GlState::instance().enable(GL_DEPTH_TEST);
+
+        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        set_frame(width, height);
+        glm::mat4 model = glm::mat4(1.0f);
+
+        renderSphere(model, color, lod < 0 ? sphere_lod(height) : lod);
+    }
+
+    void render_to_framebuffer_mesh(glm::vec3 color, float rotationX, float rotationY, MeshHandle mesh, glm::vec4 fit,
+                                    int width = 800, int height = 600)
+    {
+        m_renders += 1;
+        GlState::instance().viewport(0, 0, width, height);
+        GlState::instance().enable(GL_DEPTH_TEST);
+
+        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        set_frame(width, height);
+        use_program(preview_model(rotationX, rotationY, fit), color);
+        m_meshes.draw(mesh);
+    }
+
+private:
+    void use_program(Shader& shader, GLint modelLocation, GLint colorLocation, const glm::mat4& model,
+                     const glm::vec3& color)
+    {
+        shader.useShaderProgram();
+        glUniformMatrix4fv(modelLocation, 1, GL_FALSE, &model[0][0]);
+        glUniform3fv(colorLocation, 1, &color[0]);
+    }
+};
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+// Scales the resolution previews are drawn at to keep the frame time within a
+// budget. While previews change every frame (a time node, dragging the
+// rotation) frames over budget lower the scale and frames well below raise it
+// again; once nothing has changed for a moment the previews return to full
+// resolution.
+class PreviewResolution
+{
+public:
+    static constexpr float min_scale = 0.25f;
+    // Frames between two changes, so the effect of one is measured first
+    static constexpr int   settle_frames = 10;
+    // Seconds without changes after which previews return to full resolution
+    static constexpr float restore_seconds = 0.5f;
+
+    // The budget is $MATERIALEDITOR_FRAME_BUDGET_MS or 20 ms, which a 60 Hz
+    // display only misses when a frame misses its vsync
+    PreviewResolution()
+    {
+        const char* budget = std::getenv("MATERIALEDITOR_FRAME_BUDGET_MS");
+        const float milliseconds = budget ? std::strtof(budget, nullptr) : 0.f;
+        m_budget = milliseconds > 0.f ? milliseconds : 20.f;
+    }
+
+    float budget() const { return m_budget; }
+    void  set_budget(const float milliseconds) { m_budget = std::max(milliseconds, 1.f); }
+
+    float scale() const { return m_scale; }
+    float average_milliseconds() const { return m_average; }
+
+    // Call once per frame with the time of the last frame. active is whether
+    // previews change in this frame; measured is false for a frame time that
+    // includes waiting for input.
+    void update(const float frame_milliseconds, const bool active, const bool measured)
+    {
+        if (!active)
+        {
+            m_quiet_seconds += measured ? frame_milliseconds * 0.001f : restore_seconds;
+            if (m_quiet_seconds >= restore_seconds)
+            {
+                m_scale = 1.f;
+                m_frames = 0;
+            }
+            return;
+        }
+
+        m_quiet_seconds = 0.f;
+        if (!measured)
+        {
+            return;
+        }
+
+        m_average = m_frames == 0 ? frame_milliseconds : m_average + 0.2f * (frame_milliseconds - m_average);
+        m_frames += 1;
+        if (m_frames < settle_frames)
+        {
+            return;
+        }
+
+        if (m_average > m_budget && m_scale > min_scale)
+        {
+            m_scale = std::max(min_scale, m_scale * 0.8f);
+            m_frames = 0;
+        }
+        else if (m_average < 0.7f * m_budget && m_scale < 1.f)
+        {
+            m_scale = std::min(1.f, m_scale * 1.15f);
+            m_frames = 0;
+        }
+    }
+
+    // Pixels to draw a preview shown at display_pixels with. Rounded to
+    // multiples of 8, so small changes of the scale do not redraw every
+    // preview.
+    int pixels(const float display_pixels) const
+    {
+        const int size = static_cast<int>(std::lround(display_pixels * m_scale / 8.f)) * 8;
+        return std::max(size, 8);
+    }
+
+private:
+    float m_budget = 20.f;
+    float m_scale = 1.f;
+    float m_average = 0.f;
+    int   m_frames = 0;
+    float m_quiet_seconds = 0.f;
+};
@@ -0,0 +1,231 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <GL/glew.h>
+
+struct ProgramCacheStats
+{
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t stores = 0;
+    // Time spent creating programs, from sources or from the cache
+    double   hit_milliseconds = 0.0;
+    double   miss_milliseconds = 0.0;
+};
+
+// Linked program binaries on disk, so a program whose sources were linked
+// before by the same driver skips compiling. Files are named after a hash of
+// the sources and the driver, and carry the driver string to catch hash
+// collisions and driver updates. A binary the driver rejects is compiled
+// from source again and replaced.
+//
+// The directory is $MATERIALEDITOR_SHADER_CACHE or a folder in the temp
+// directory. Setting the variable to an empty string turns the cache off.
+class ProgramBinaryCache
+{
+public:
+    using Sources = std::vector<std::pair<GLenum, std::string>>;
+
+    static ProgramBinaryCache& instance()
+    {
+        static ProgramBinaryCache cache;
+        return cache;
+    }
+
+    // Needs a current context, binaries are only supported by some drivers
+    bool enabled()
+    {
+        if (!m_checked)
+        {
+            m_checked = true;
+            GLint formats = 0;
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+            m_enabled = m_enabled && formats > 0;
+
+            const auto text = [](GLenum name) {
+                const GLubyte* value = glGetString(name);
+                return value ? std::string(reinterpret_cast<const char*>(value)) : std::string();
+            };
+            m_driver = text(GL_VENDOR) + "|" + text(GL_RENDERER) + "|" + text(GL_VERSION);
+        }
+        return m_enabled;
+    }
+
+    std::string key(const Sources& sources)
+    {
+        enabled();
+        uint64_t hash = 14695981039346656037ull;
+        const auto mix = [&hash](const void* data, size_t size) {
+            for (size_t i = 0; i < size; ++i)
+            {
+                hash = (hash ^ static_cast<const uint8_t*>(data)[i]) * 1099511628211ull;
+            }
+        };
+        mix(m_driver.data(), m_driver.size());
+        for (const auto& [type, source] : sources)
+        {
+            mix(&type, sizeof(type));
+            mix(source.data(), source.size());
+        }
+
+        char name[17];
+        std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(hash));
+        return name;
+    }
+
+    // Loads the binary stored under key into program. Returns false if there
+    // is none or the driver did not accept it; program has to be linked from
+    // source then.
+    bool load(const std::string& key, const GLuint program)
+    {
+        if (!enabled())
+        {
+            return false;
+        }
+
+        std::ifstream file(path(key), std::ios::binary);
+        if (!file.is_open())
+        {
+            return false;
+        }
+
+        Header header;
+        if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != magic ||
+            header.version != version || header.driver_length != m_driver.size())
+        {
+            return false;
+        }
+
+        std::string driver(header.driver_length, '\0');
+        file.read(driver.data(), driver.size());
+        std::vector<char> binary(header.binary_length);
+        file.read(binary.data(), binary.size());
+        if (!file || driver != m_driver)
+        {
+            return false;
+        }
+
+        glProgramBinary(program, header.format, binary.data(), static_cast<GLsizei>(binary.size()));
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        return linked == GL_TRUE;
+    }
+
+    // Call before linking a program that will be stored
+    void prepare(const GLuint program)
+    {
+        if (enabled())
+        {
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        }
+    }
+
+    void store(const std::string& key, const GLuint program)
+    {
+        if (!enabled())
+        {
+            return;
+        }
+
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+        {
+            return;
+        }
+
+        Header header;
+        std::vector<char> binary(length);
+        GLsizei written = 0;
+        glGetProgramBinary(program, length, &written, &header.format, binary.data());
+        header.driver_length = static_cast<uint32_t>(m_driver.size());
+        header.binary_length = static_cast<uint32_t>(written);
+
+        std::error_code error;
+        std::filesystem::create_directories(m_directory, error);
+
+        // Written next to the final name and renamed, so that a concurrent
+        // editor never reads half a file
+        const std::filesystem::path final_path = path(key);
+        std::filesystem::path temporary_path = final_path;
+        temporary_path += ".tmp";
+        {
+            std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+            if (!file.is_open())
+            {
+                std::cerr << "[WARN] Cannot write shader cache " << temporary_path.string() << "\n";
+                return;
+            }
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(m_driver.data(), m_driver.size());
+            file.write(binary.data(), written);
+        }
+        std::filesystem::rename(temporary_path, final_path, error);
+        if (!error)
+        {
+            m_stats.stores += 1;
+        }
+    }
+
+    void record(const bool hit, const std::chrono::steady_clock::duration time)
+    {
+        const double milliseconds = std::chrono::duration<double, std::milli>(time).count();
+        if (hit)
+        {
+            m_stats.hits += 1;
+            m_stats.hit_milliseconds += milliseconds;
+        }
+        else
+        {
+            m_stats.misses += 1;
+            m_stats.miss_milliseconds += milliseconds;
+        }
+    }
+
+    const ProgramCacheStats& stats() const { return m_stats; }
+    const std::filesystem::path& directory() const { return m_directory; }
+
+private:
+    static constexpr uint32_t magic = 0x4250454d; // "MEPB"
+    static constexpr uint32_t version = 1;
+
+    struct Header
+    {
+        uint32_t magic = ProgramBinaryCache::magic;
+        uint32_t version = ProgramBinaryCache::version;
+        GLenum   format = 0;
+        uint32_t driver_length = 0;
+        uint32_t binary_length = 0;
+    };
+
+    ProgramBinaryCache()
+    {
+        if (const char* directory = std::getenv("MATERIALEDITOR_SHADER_CACHE"))
+        {
+            m_directory = directory;
+            m_enabled = !m_directory.empty();
+        }
+        else
+        {
+            std::error_code error;
+            m_directory = std::filesystem::temp_directory_path(error) / "materialeditor-shader-cache";
+        }
+    }
+
+    std::filesystem::path path(const std::string& key) const { return m_directory / (key + ".bin"); }
+
+    std::filesystem::path m_directory;
+    std::string           m_driver;
+    bool                  m_enabled = true;
+    bool                  m_checked = false;
+    ProgramCacheStats     m_stats;
+};
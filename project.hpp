@@ -0,0 +1,450 @@
+#pragma once
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+#include "node.hpp"
+#include "graph.hpp"
+
+enum class UiNodeType
+{
+    add,
+    multiply,
+    output,
+    sine,
+    time,
+    power,
+    cubeviewport,
+    sphereviewport,
+    meshviewport,
+    texture
+};
+
+struct UiNode
+{
+    UiNodeType type;
+    // The identifying id of the ui node. For add, multiply, sine, and time
+    // this is the "operation" node id. The additional input nodes are
+    // stored in the structs.
+    int id;
+    // Grid space position in the node editor, kept up to date when saving
+    float x = 0.f;
+    float y = 0.f;
+    // OBJ file of a mesh viewport or image of a texture node
+    std::string path;
+
+    union
+    {
+        struct
+        {
+            int lhs, rhs;
+        } add;
+
+        struct
+        {
+            int lhs, rhs;
+        } multiply;
+
+        struct
+        {
+            int lhs, rhs;
+        } power;
+
+        struct
+        {
+            int r, g, b;
+        } output;
+
+        struct
+        {
+            int input;
+        } sine;
+
+        struct
+        {
+            int input;
+        } cubeviewport;
+
+        struct
+        {
+            int input;
+        } sphereviewport;
+
+        struct
+        {
+            int input;
+        } meshviewport;
+
+    } ui;
+};
+
+// The value nodes backing the input pins of a ui node.
+inline std::vector<int> ui_node_inputs(const UiNode& node)
+{
+    switch (node.type)
+    {
+    case UiNodeType::add:
+        return {node.ui.add.lhs, node.ui.add.rhs};
+    case UiNodeType::multiply:
+        return {node.ui.multiply.lhs, node.ui.multiply.rhs};
+    case UiNodeType::power:
+        return {node.ui.power.lhs, node.ui.power.rhs};
+    case UiNodeType::output:
+        return {node.ui.output.r, node.ui.output.g, node.ui.output.b};
+    case UiNodeType::sine:
+        return {node.ui.sine.input};
+    case UiNodeType::cubeviewport:
+        return {node.ui.cubeviewport.input};
+    case UiNodeType::sphereviewport:
+        return {node.ui.sphereviewport.input};
+    case UiNodeType::meshviewport:
+        return {node.ui.meshviewport.input};
+    default:
+        return {};
+    }
+}
+
+// The inverse of ui_node_inputs. Returns false if the number of inputs does
+// not match the node type.
+inline bool set_ui_node_inputs(UiNode& node, const std::vector<int>& inputs)
+{
+    if (inputs.size() != ui_node_inputs(node).size())
+    {
+        return false;
+    }
+
+    switch (node.type)
+    {
+    case UiNodeType::add:
+        node.ui.add = {inputs[0], inputs[1]};
+        break;
+    case UiNodeType::multiply:
+        node.ui.multiply = {inputs[0], inputs[1]};
+        break;
+    case UiNodeType::power:
+        node.ui.power = {inputs[0], inputs[1]};
+        break;
+    case UiNodeType::output:
+        node.ui.output = {inputs[0], inputs[1], inputs[2]};
+        break;
+    case UiNodeType::sine:
+        node.ui.sine.input = inputs[0];
+        break;
+    case UiNodeType::cubeviewport:
+        node.ui.cubeviewport.input = inputs[0];
+        break;
+    case UiNodeType::sphereviewport:
+        node.ui.sphereviewport.input = inputs[0];
+        break;
+    case UiNodeType::meshviewport:
+        node.ui.meshviewport.input = inputs[0];
+        break;
+    default:
+        break;
+    }
+    return true;
+}
+
+// Everything that is stored in a project file. It holds no GL or ImGui state,
+// so the headless tools can load and evaluate projects without a window.
+struct Project
+{
+    Graph<Node>         graph;
+    std::vector<UiNode> nodes;
+    int                 root_node_id = -1;
+};
+
+inline nlohmann::json ui_node_to_json(const UiNode& node)
+{
+    nlohmann::json node_json;
+    node_json["id"] = node.id;
+    node_json["type"] = static_cast<int>(node.type);
+    node_json["x"] = node.x;
+    node_json["y"] = node.y;
+
+    switch (node.type)
+    {
+    case UiNodeType::add:
+        node_json["lhs"] = node.ui.add.lhs;
+        node_json["rhs"] = node.ui.add.rhs;
+        break;
+    case UiNodeType::multiply:
+        node_json["lhs"] = node.ui.multiply.lhs;
+        node_json["rhs"] = node.ui.multiply.rhs;
+        break;
+    case UiNodeType::power:
+        node_json["lhs"] = node.ui.power.lhs;
+        node_json["rhs"] = node.ui.power.rhs;
+        break;
+    case UiNodeType::output:
+        node_json["r"] = node.ui.output.r;
+        node_json["g"] = node.ui.output.g;
+        node_json["b"] = node.ui.output.b;
+        break;
+    case UiNodeType::sine:
+        node_json["input"] = node.ui.sine.input;
+        break;
+    case UiNodeType::cubeviewport:
+        node_json["input"] = node.ui.cubeviewport.input;
+        break;
+    case UiNodeType::sphereviewport:
+        node_json["input"] = node.ui.sphereviewport.input;
+        break;
+    case UiNodeType::meshviewport:
+        node_json["input"] = node.ui.meshviewport.input;
+        node_json["path"] = node.path;
+        break;
+    case UiNodeType::texture:
+        node_json["path"] = node.path;
+        break;
+    default:
+        break;
+    }
+
+    return node_json;
+}
+
+inline UiNode ui_node_from_json(const nlohmann::json& node_json)
+{
+    UiNode ui_node;
+    ui_node.id = node_json["id"];
+    ui_node.type = static_cast<UiNodeType>(node_json["type"]);
+    ui_node.x = node_json.value("x", 0.f);
+    ui_node.y = node_json.value("y", 0.f);
+
+    switch (ui_node.type)
+    {
+    case UiNodeType::add:
+        ui_node.ui.add.lhs = node_json["lhs"];
+        ui_node.ui.add.rhs = node_json["rhs"];
+        break;
+    case UiNodeType::multiply:
+        ui_node.ui.multiply.lhs = node_json["lhs"];
+        ui_node.ui.multiply.rhs = node_json["rhs"];
+        break;
+    case UiNodeType::power:
+        ui_node.ui.power.lhs = node_json["lhs"];
+        ui_node.ui.power.rhs = node_json["rhs"];
+        break;
+    case UiNodeType::output:
+        ui_node.ui.output.r = node_json["r"];
+        ui_node.ui.output.g = node_json["g"];
+        ui_node.ui.output.b = node_json["b"];
+        break;
+    case UiNodeType::sine:
+        ui_node.ui.sine.input = node_json["input"];
+        break;
+    case UiNodeType::cubeviewport:
+        ui_node.ui.cubeviewport.input = node_json["input"];
+        break;
+    case UiNodeType::sphereviewport:
+        ui_node.ui.sphereviewport.input = node_json["input"];
+        break;
+    case UiNodeType::meshviewport:
+        ui_node.ui.meshviewport.input = node_json["input"];
+        ui_node.path = node_json.value("path", std::string());
+        break;
+    case UiNodeType::texture:
+        ui_node.path = node_json.value("path", std::string());
+        break;
+    default:
+        break;
+    }
+
+    return ui_node;
+}
+
+inline nlohmann::json graph_node_to_json(const Graph<Node>& graph, const int id)
+{
+    const Node& node = graph.node(id);
+    return {{"id", id}, {"type", static_cast<int>(node.type)}, {"value", node.value}};
+}
+
+inline nlohmann::json edge_to_json(const Graph<Node>::Edge& edge)
+{
+    return {{"id", edge.id}, {"from", edge.from}, {"to", edge.to}};
+}
+
+inline nlohmann::json project_to_json(const Project& project)
+{
+    nlohmann::json j;
+
+    // Uložení uzlů
+    j["nodes"] = nlohmann::json::array();
+    for (const auto& node : project.nodes)
+    {
+        j["nodes"].push_back(ui_node_to_json(node));
+    }
+
+    // The graph nodes carry the values typed into the node widgets
+    j["graph"] = nlohmann::json::array();
+    for (const int id : project.graph.node_ids())
+    {
+        j["graph"].push_back(graph_node_to_json(project.graph, id));
+    }
+
+    j["edges"] = nlohmann::json::array();
+    for (const auto& edge : project.graph.edges())
+    {
+        j["edges"].push_back(edge_to_json(edge));
+    }
+
+    return j;
+}
+
+// The contents of a project file, or of a part of one, before they are
+// inserted into a Project.
+struct ProjectPart
+{
+    struct GraphNode
+    {
+        int      id;
+        NodeType type;
+        float    value;
+    };
+
+    std::vector<GraphNode>         graph;
+    std::vector<UiNode>            nodes;
+    std::vector<Graph<Node>::Edge> edges;
+};
+
+inline ProjectPart project_part_from_json(const nlohmann::json& j)
+{
+    ProjectPart part;
+    for (const auto& node_json : j["graph"])
+    {
+        part.graph.push_back({node_json["id"].get<int>(), static_cast<NodeType>(node_json["type"].get<int>()),
+                              node_json["value"].get<float>()});
+    }
+    for (const auto& node_json : j["nodes"])
+    {
+        part.nodes.push_back(ui_node_from_json(node_json));
+    }
+    for (const auto& edge_json : j["edges"])
+    {
+        part.edges.emplace_back(edge_json["id"].get<int>(), edge_json["from"].get<int>(), edge_json["to"].get<int>());
+    }
+    return part;
+}
+
+// Adds the graph and ui nodes of a project (or a part of one) to project.
+inline bool insert_project_nodes(const ProjectPart& part, Project& project)
+{
+    for (const ProjectPart::GraphNode& node : part.graph)
+    {
+        if (project.graph.node_exists(node.id))
+        {
+            std::cerr << "Error: duplicate node id " << node.id << std::endl;
+            return false;
+        }
+        project.graph.insert_node(node.id, Node(node.type, node.value));
+    }
+
+    for (const UiNode& ui_node : part.nodes)
+    {
+        if (!project.graph.node_exists(ui_node.id))
+        {
+            std::cerr << "Error: ui node " << ui_node.id << " has no graph node." << std::endl;
+            return false;
+        }
+
+        for (const int input : ui_node_inputs(ui_node))
+        {
+            if (!project.graph.node_exists(input))
+            {
+                std::cerr << "Error: ui node " << ui_node.id << " is missing input " << input << std::endl;
+                return false;
+            }
+        }
+
+        if (ui_node.type == UiNodeType::output)
+        {
+            project.root_node_id = ui_node.id;
+        }
+
+        project.nodes.push_back(ui_node);
+    }
+
+    return true;
+}
+
+// Adds the edges of a project (or a part of one). Both ends must already be
+// in the graph.
+inline void insert_project_edges(const ProjectPart& part, Project& project)
+{
+    for (const Graph<Node>::Edge& edge : part.edges)
+    {
+        if (project.graph.edge_exists(edge.id))
+        {
+            std::cerr << "Error: duplicate edge id " << edge.id << std::endl;
+            continue;
+        }
+
+        if (!project.graph.node_exists(edge.from) || !project.graph.node_exists(edge.to))
+        {
+            std::cerr << "Error: Invalid edge. Missing nodes: " << edge.from << " or " << edge.to << std::endl;
+            continue; // Přeskočte chybnou hranu
+        }
+
+        project.graph.insert_edge(edge.id, edge.from, edge.to);
+    }
+}
+
+inline bool project_from_json(const nlohmann::json& j, Project& project)
+{
+    project = Project();
+
+    if (!j.contains("graph"))
+    {
+        std::cerr << "Error: project has no graph section." << std::endl;
+        return false;
+    }
+
+    const ProjectPart part = project_part_from_json(j);
+    if (!insert_project_nodes(part, project))
+    {
+        return false;
+    }
+
+    insert_project_edges(part, project);
+    return true;
+}
+
+inline bool save_project_json(const Project& project, const std::string& filename)
+{
+    std::ofstream file(filename);
+    if (!file.is_open())
+    {
+        std::cerr << "save file failed! " << filename << std::endl;
+        return false;
+    }
+
+    file << project_to_json(project).dump(4);
+    return true;
+}
+
+inline bool load_project_json(Project& project, const std::string& filename)
+{
+    std::ifstream file(filename);
+    if (!file.is_open())
+    {
+        std::cerr << "read file failed! " << filename << std::endl;
+        return false;
+    }
+
+    try
+    {
+        nlohmann::json j;
+        file >> j;
+        return project_from_json(j, project);
+    }
+    catch (const nlohmann::json::exception& e)
+    {
+        std::cerr << "Error: cannot parse project " << filename << ": " << e.what() << std::endl;
+        project = Project();
+        return false;
+    }
+}
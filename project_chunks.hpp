@@ -0,0 +1,824 @@
+#pragma once
+
+// Chunked project files. The nodes are split by their position in the editor
+// into square regions, and every region is stored as an independent chunk,
+// so the editor only has to read and construct the part of a large project
+// that is on screen or needed to evaluate it.
+//
+// Layout:
+//   "MEPC"               magic
+//   uint32               version
+//   uint64               size of the index
+//   index                JSON, see write_chunked_project
+//   chunk payloads       see encode_chunk, optionally compressed as LZ4 blocks
+//
+// All integers are little endian. Chunks are compressed independently, so
+// they can be decompressed and parsed on several threads.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+#include "project.hpp"
+#include "lz4_block.hpp"
+#include "thread_pool.hpp"
+
+inline constexpr char     chunked_project_magic[4] = {'M', 'E', 'P', 'C'};
+inline constexpr uint32_t chunked_project_version = 1;
+
+// Edge length of the square regions, in editor grid units
+inline constexpr float chunk_region_size = 2048.f;
+// Dense regions are split further, which keeps the chunks small enough to
+// decode in parallel
+inline constexpr size_t chunk_max_nodes = 1024;
+
+enum class ChunkCodec
+{
+    none,
+    lz4
+};
+
+template<typename T>
+void write_le(std::ostream& out, const T value)
+{
+    unsigned char bytes[sizeof(T)];
+    for (size_t i = 0; i < sizeof(T); ++i)
+    {
+        bytes[i] = static_cast<unsigned char>(static_cast<uint64_t>(value) >> (8 * i));
+    }
+    out.write(reinterpret_cast<const char*>(bytes), sizeof(T));
+}
+
+template<typename T>
+bool read_le(std::istream& in, T& value)
+{
+    unsigned char bytes[sizeof(T)];
+    if (!in.read(reinterpret_cast<char*>(bytes), sizeof(T)))
+    {
+        return false;
+    }
+    uint64_t result = 0;
+    for (size_t i = 0; i < sizeof(T); ++i)
+    {
+        result |= static_cast<uint64_t>(bytes[i]) << (8 * i);
+    }
+    value = static_cast<T>(result);
+    return true;
+}
+
+template<typename T>
+void append_le(std::vector<uint8_t>& out, const T value)
+{
+    for (size_t i = 0; i < sizeof(T); ++i)
+    {
+        out.push_back(static_cast<uint8_t>(static_cast<uint64_t>(value) >> (8 * i)));
+    }
+}
+
+inline void append_float_le(std::vector<uint8_t>& out, const float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    append_le(out, bits);
+}
+
+// Bounds checked reads from a chunk payload. After a read past the end all
+// further reads return 0 and ok() is false.
+class ChunkCursor
+{
+public:
+    ChunkCursor(const uint8_t* data, const size_t size) : m_data(data), m_size(size) {}
+
+    template<typename T>
+    T read()
+    {
+        if (m_size - m_pos < sizeof(T))
+        {
+            m_pos = m_size;
+            m_ok = false;
+            return T(0);
+        }
+        uint64_t result = 0;
+        for (size_t i = 0; i < sizeof(T); ++i)
+        {
+            result |= static_cast<uint64_t>(m_data[m_pos + i]) << (8 * i);
+        }
+        m_pos += sizeof(T);
+        return static_cast<T>(result);
+    }
+
+    int read_int() { return static_cast<int32_t>(read<uint32_t>()); }
+
+    float read_float()
+    {
+        const uint32_t bits = read<uint32_t>();
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    bool ok() const { return m_ok; }
+    bool at_end() const { return m_pos == m_size; }
+
+private:
+    const uint8_t* m_data;
+    size_t         m_size;
+    size_t         m_pos = 0;
+    bool           m_ok = true;
+};
+
+// A chunk payload is three arrays of fixed size records, each preceded by a
+// uint32 count:
+//   graph nodes   int32 id, uint8 type, float32 value
+//   ui nodes      int32 id, uint8 type, float32 x, float32 y,
+//                 uint8 input count, int32 inputs...,
+//                 uint16 path length, path bytes
+//   edges         int32 id, int32 from, int32 to
+inline std::vector<uint8_t> encode_chunk(const ProjectPart& part)
+{
+    std::vector<uint8_t> out;
+    out.reserve(12 + part.graph.size() * 9 + part.nodes.size() * 22 + part.edges.size() * 12);
+
+    append_le<uint32_t>(out, static_cast<uint32_t>(part.graph.size()));
+    for (const ProjectPart::GraphNode& node : part.graph)
+    {
+        append_le<uint32_t>(out, static_cast<uint32_t>(node.id));
+        append_le<uint8_t>(out, static_cast<uint8_t>(node.type));
+        append_float_le(out, node.value);
+    }
+
+    append_le<uint32_t>(out, static_cast<uint32_t>(part.nodes.size()));
+    for (const UiNode& node : part.nodes)
+    {
+        const std::vector<int> inputs = ui_node_inputs(node);
+        append_le<uint32_t>(out, static_cast<uint32_t>(node.id));
+        append_le<uint8_t>(out, static_cast<uint8_t>(node.type));
+        append_float_le(out, node.x);
+        append_float_le(out, node.y);
+        append_le<uint8_t>(out, static_cast<uint8_t>(inputs.size()));
+        for (const int input : inputs)
+        {
+            append_le<uint32_t>(out, static_cast<uint32_t>(input));
+        }
+        const size_t path_length = std::min<size_t>(node.path.size(), UINT16_MAX);
+        append_le<uint16_t>(out, static_cast<uint16_t>(path_length));
+        out.insert(out.end(), node.path.begin(), node.path.begin() + path_length);
+    }
+
+    append_le<uint32_t>(out, static_cast<uint32_t>(part.edges.size()));
+    for (const Graph<Node>::Edge& edge : part.edges)
+    {
+        append_le<uint32_t>(out, static_cast<uint32_t>(edge.id));
+        append_le<uint32_t>(out, static_cast<uint32_t>(edge.from));
+        append_le<uint32_t>(out, static_cast<uint32_t>(edge.to));
+    }
+
+    return out;
+}
+
+inline bool decode_chunk_records(const uint8_t* data, const size_t size, ProjectPart& part)
+{
+    ChunkCursor cursor(data, size);
+
+    // Counts are checked against the remaining bytes before reserving
+    const uint32_t graph_count = cursor.read<uint32_t>();
+    if (graph_count > size / 9)
+    {
+        return false;
+    }
+    part.graph.resize(graph_count);
+    for (ProjectPart::GraphNode& node : part.graph)
+    {
+        node.id = cursor.read_int();
+        node.type = static_cast<NodeType>(cursor.read<uint8_t>());
+        node.value = cursor.read_float();
+    }
+
+    const uint32_t node_count = cursor.read<uint32_t>();
+    if (node_count > size / 14)
+    {
+        return false;
+    }
+    part.nodes.resize(node_count);
+    std::vector<int> inputs;
+    for (UiNode& node : part.nodes)
+    {
+        node.id = cursor.read_int();
+        node.type = static_cast<UiNodeType>(cursor.read<uint8_t>());
+        node.x = cursor.read_float();
+        node.y = cursor.read_float();
+        inputs.resize(cursor.read<uint8_t>());
+        for (int& input : inputs)
+        {
+            input = cursor.read_int();
+        }
+        if (!set_ui_node_inputs(node, inputs))
+        {
+            return false;
+        }
+        node.path.resize(cursor.read<uint16_t>());
+        for (char& c : node.path)
+        {
+            c = static_cast<char>(cursor.read<uint8_t>());
+        }
+    }
+
+    const uint32_t edge_count = cursor.read<uint32_t>();
+    if (edge_count > size / 12)
+    {
+        return false;
+    }
+    part.edges.resize(edge_count);
+    for (Graph<Node>::Edge& edge : part.edges)
+    {
+        edge.id = cursor.read_int();
+        edge.from = cursor.read_int();
+        edge.to = cursor.read_int();
+    }
+
+    return cursor.ok() && cursor.at_end();
+}
+
+// Turns the stored bytes of a chunk back into its contents. Touches no
+// shared state, so it can run on any thread.
+inline bool decode_chunk(const std::vector<uint8_t>& bytes, const ChunkCodec codec, const uint64_t raw_size,
+                         ProjectPart& part)
+{
+    if (codec == ChunkCodec::none)
+    {
+        return decode_chunk_records(bytes.data(), bytes.size(), part);
+    }
+
+    std::vector<uint8_t> raw(raw_size);
+    return lz4::decompress(bytes.data(), bytes.size(), raw.data(), raw.size()) &&
+           decode_chunk_records(raw.data(), raw.size(), part);
+}
+
+inline bool is_chunked_project_file(const std::string& filename)
+{
+    std::ifstream file(filename, std::ios::binary);
+    char magic[4] = {};
+    return file.read(magic, 4) && std::memcmp(magic, chunked_project_magic, 4) == 0;
+}
+
+// The index lists for every chunk:
+//   "offset", "size"  where its payload is, relative to the end of the index
+//   "bounds"          [x0, y0, x1, y1] of the node positions in it
+//   "deps"            chunks that edges from this chunk point into
+//   "codec", "raw_size"  only for compressed chunks: "lz4" and the size
+//                        before compression
+// plus "next_id" of the graph and "root_chunk", the chunk with the output node.
+inline bool write_chunked_project(
+    const Project& project, const std::string& filename, const ChunkCodec codec = ChunkCodec::none)
+{
+    struct Chunk
+    {
+        float               bounds[4];
+        std::vector<size_t> deps;
+        ProjectPart         part;
+    };
+
+    std::vector<Chunk>                    chunks;
+    std::map<std::pair<int, int>, size_t> chunk_of_region;
+    std::unordered_map<int, size_t>       chunk_of_node;
+    size_t                                root_chunk = 0;
+
+    for (const UiNode& node : project.nodes)
+    {
+        const std::pair<int, int> region(
+            static_cast<int>(std::floor(node.x / chunk_region_size)),
+            static_cast<int>(std::floor(node.y / chunk_region_size)));
+
+        auto iter = chunk_of_region.find(region);
+        if (iter == chunk_of_region.end())
+        {
+            iter = chunk_of_region.emplace(region, chunks.size()).first;
+            chunks.push_back(Chunk{{node.x, node.y, node.x, node.y}, {}, {}});
+        }
+
+        if (chunks[iter->second].part.nodes.size() >= chunk_max_nodes)
+        {
+            // Later nodes of the region go into a new chunk
+            iter->second = chunks.size();
+            chunks.push_back(Chunk{{node.x, node.y, node.x, node.y}, {}, {}});
+        }
+
+        const size_t index = iter->second;
+        Chunk& chunk = chunks[index];
+        chunk.bounds[0] = std::min(chunk.bounds[0], node.x);
+        chunk.bounds[1] = std::min(chunk.bounds[1], node.y);
+        chunk.bounds[2] = std::max(chunk.bounds[2], node.x);
+        chunk.bounds[3] = std::max(chunk.bounds[3], node.y);
+        chunk.part.nodes.push_back(node);
+
+        chunk_of_node[node.id] = index;
+        for (const int input : ui_node_inputs(node))
+        {
+            chunk_of_node[input] = index;
+        }
+
+        if (node.id == project.root_node_id)
+        {
+            root_chunk = index;
+        }
+    }
+
+    if (chunks.empty() && project.graph.node_ids().begin() != project.graph.node_ids().end())
+    {
+        chunks.push_back(Chunk{{0.f, 0.f, 0.f, 0.f}, {}, {}});
+    }
+
+    // Graph nodes without a ui node go along with the output node
+    for (const int id : project.graph.node_ids())
+    {
+        auto iter = chunk_of_node.find(id);
+        if (iter == chunk_of_node.end())
+        {
+            iter = chunk_of_node.emplace(id, root_chunk).first;
+        }
+        const Node& node = project.graph.node(id);
+        chunks[iter->second].part.graph.push_back({id, node.type, node.value});
+    }
+
+    // An edge is stored with the node it starts at, i.e. the input pin, and
+    // makes its chunk depend on the chunk of the node producing the value
+    for (const auto& edge : project.graph.edges())
+    {
+        const size_t from = chunk_of_node[edge.from];
+        const size_t to = chunk_of_node[edge.to];
+        chunks[from].part.edges.push_back(edge);
+        std::vector<size_t>& deps = chunks[from].deps;
+        if (from != to && std::find(deps.begin(), deps.end(), to) == deps.end())
+        {
+            deps.push_back(to);
+        }
+    }
+
+    nlohmann::json index;
+    index["next_id"] = project.graph.next_id();
+    index["root_chunk"] = root_chunk;
+    index["chunks"] = nlohmann::json::array();
+
+    // Encoding and compressing the chunks is independent work
+    struct Encoded
+    {
+        std::vector<uint8_t> bytes;
+        uint64_t             raw_size = 0;
+        bool                 compressed = false;
+    };
+    std::vector<Encoded> payloads(chunks.size());
+    {
+        ThreadPool pool(std::min<size_t>(chunks.size(), std::thread::hardware_concurrency()));
+        std::vector<std::future<void>> done;
+        for (size_t i = 0; i < chunks.size(); ++i)
+        {
+            done.push_back(pool.submit([&chunk = chunks[i], &encoded = payloads[i], codec] {
+                encoded.bytes = encode_chunk(chunk.part);
+                encoded.raw_size = encoded.bytes.size();
+                if (codec == ChunkCodec::lz4)
+                {
+                    std::vector<uint8_t> compressed = lz4::compress(encoded.bytes.data(), encoded.bytes.size());
+                    // Incompressible chunks are stored as they are
+                    if (compressed.size() < encoded.bytes.size())
+                    {
+                        encoded.bytes = std::move(compressed);
+                        encoded.compressed = true;
+                    }
+                }
+            }));
+        }
+        for (auto& future : done)
+        {
+            future.get();
+        }
+    }
+
+    uint64_t offset = 0;
+    for (size_t i = 0; i < chunks.size(); ++i)
+    {
+        nlohmann::json chunk_json = {{"offset", offset},
+                                     {"size", payloads[i].bytes.size()},
+                                     {"bounds", chunks[i].bounds},
+                                     {"deps", chunks[i].deps}};
+        if (payloads[i].compressed)
+        {
+            chunk_json["codec"] = "lz4";
+            chunk_json["raw_size"] = payloads[i].raw_size;
+        }
+        index["chunks"].push_back(chunk_json);
+        offset += payloads[i].bytes.size();
+    }
+
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cerr << "save file failed! " << filename << std::endl;
+        return false;
+    }
+
+    const std::string index_text = index.dump();
+    file.write(chunked_project_magic, 4);
+    write_le<uint32_t>(file, chunked_project_version);
+    write_le<uint64_t>(file, index_text.size());
+    file.write(index_text.data(), static_cast<std::streamsize>(index_text.size()));
+    for (const Encoded& payload : payloads)
+    {
+        file.write(reinterpret_cast<const char*>(payload.bytes.data()),
+                   static_cast<std::streamsize>(payload.bytes.size()));
+    }
+
+    if (!file)
+    {
+        std::cerr << "save file failed! " << filename << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Keeps a chunked project file open and adds its chunks to a Project on
+// demand. Loading a chunk first loads every chunk it depends on, so all
+// inputs of the loaded nodes are in the graph and evaluate correctly.
+// When several chunks are needed at once, the file is read sequentially and
+// the chunks are decompressed and parsed on a thread pool; only inserting
+// them into the project is serial.
+class ChunkedProjectReader
+{
+public:
+    ChunkedProjectReader() = default;
+    // Decodes on decoders instead of a pool of its own, or on the calling
+    // thread if it is null, for callers that already run on a pool worker
+    explicit ChunkedProjectReader(ThreadPool* decoders) : m_decoders(decoders), m_shared_decoders(true) {}
+
+    bool open(const std::string& filename, Project& project)
+    {
+        close();
+        project = Project();
+
+        m_file.open(filename, std::ios::binary | std::ios::ate);
+        const uint64_t file_size = m_file ? static_cast<uint64_t>(m_file.tellg()) : 0;
+        m_file.seekg(0);
+        char magic[4] = {};
+        uint32_t version = 0;
+        uint64_t index_size = 0;
+        if (!m_file.read(magic, 4) || std::memcmp(magic, chunked_project_magic, 4) != 0 ||
+            !read_le(m_file, version) || !read_le(m_file, index_size))
+        {
+            std::cerr << "read file failed! " << filename << std::endl;
+            close();
+            return false;
+        }
+
+        if (version != chunked_project_version)
+        {
+            std::cerr << "Error: unsupported project version " << version << std::endl;
+            close();
+            return false;
+        }
+
+        // Sizes come from the file, they are checked before anything is
+        // allocated for them
+        if (index_size > file_size - 16)
+        {
+            std::cerr << "Error: project index is larger than the file " << filename << std::endl;
+            close();
+            return false;
+        }
+        const uint64_t data_size = file_size - 16 - index_size;
+
+        try
+        {
+            std::string index_text(index_size, '\0');
+            read_bytes(&index_text[0], index_size);
+            const nlohmann::json index = nlohmann::json::parse(index_text);
+
+            for (const auto& chunk_json : index["chunks"])
+            {
+                Chunk chunk;
+                chunk.offset = chunk_json["offset"];
+                chunk.size = chunk_json["size"];
+                for (int i = 0; i < 4; ++i)
+                {
+                    chunk.bounds[i] = chunk_json["bounds"][i];
+                }
+                chunk.deps = chunk_json["deps"].get<std::vector<size_t>>();
+                if (chunk_json.value("codec", std::string()) == "lz4")
+                {
+                    chunk.codec = ChunkCodec::lz4;
+                    chunk.raw_size = chunk_json["raw_size"];
+                }
+                if (chunk.size > data_size || chunk.offset > data_size - chunk.size ||
+                    chunk.raw_size > lz4::decompress_bound(chunk.size))
+                {
+                    std::cerr << "Error: project chunk " << m_chunks.size() << " does not fit the file " << filename
+                              << std::endl;
+                    close();
+                    project = Project();
+                    return false;
+                }
+                m_chunks.push_back(chunk);
+            }
+
+            m_data_offset = 16 + index_size;
+            m_project = &project;
+            project.graph.reserve_ids(index["next_id"].get<int>());
+
+            // The output window evaluates the output node from the first frame
+            const size_t root_chunk = index["root_chunk"];
+            if (root_chunk < m_chunks.size())
+            {
+                materialize_chunk(root_chunk);
+            }
+        }
+        catch (const nlohmann::json::exception& e)
+        {
+            std::cerr << "Error: cannot parse project index " << filename << ": " << e.what() << std::endl;
+            close();
+            project = Project();
+            return false;
+        }
+
+        return true;
+    }
+
+    void close()
+    {
+        m_file.close();
+        m_chunks.clear();
+        m_new_nodes.clear();
+        m_project = nullptr;
+    }
+
+    bool is_open() const { return m_project != nullptr; }
+
+    // Called with the size of every read from the file, after it
+    using ReadCallback = std::function<void(uint64_t bytes)>;
+    void set_read_callback(ReadCallback callback) { m_read_callback = std::move(callback); }
+
+    // Loads the chunks whose nodes may be visible in the given grid space
+    // rectangle. margin is added to the chunk bounds, which only cover the
+    // top left corners of the nodes.
+    size_t materialize_region(float x0, float y0, float x1, float y1, float margin = 400.f)
+    {
+        std::vector<size_t> visible;
+        for (size_t i = 0; i < m_chunks.size(); ++i)
+        {
+            const Chunk& chunk = m_chunks[i];
+            if (chunk.loaded || chunk.failed || chunk.bounds[0] - margin > x1 || chunk.bounds[2] + margin < x0 ||
+                chunk.bounds[1] - margin > y1 || chunk.bounds[3] + margin < y0)
+            {
+                continue;
+            }
+            visible.push_back(i);
+        }
+        return materialize_chunks(visible);
+    }
+
+    // Returns whether every chunk of the file is in the project now
+    bool materialize_all()
+    {
+        std::vector<size_t> all(m_chunks.size());
+        for (size_t i = 0; i < all.size(); ++i)
+        {
+            all[i] = i;
+        }
+        materialize_chunks(all);
+        return loaded_chunk_count() == m_chunks.size();
+    }
+
+    size_t materialize_chunk(const size_t index) { return materialize_chunks({index}); }
+
+    // Loads the given chunks together with every chunk they depend on.
+    // Returns the number of chunks that were read, including dependencies.
+    // Chunks that cannot be read are marked failed and not tried again.
+    size_t materialize_chunks(const std::vector<size_t>& indices)
+    {
+        if (!m_project)
+        {
+            return 0;
+        }
+
+        std::vector<size_t> pending;
+        std::vector<bool>   visited(m_chunks.size(), false);
+        std::vector<size_t> stack(indices.begin(), indices.end());
+        while (!stack.empty())
+        {
+            const size_t index = stack.back();
+            stack.pop_back();
+            if (index >= m_chunks.size() || visited[index] || m_chunks[index].loaded || m_chunks[index].failed)
+            {
+                continue;
+            }
+            // Visited first, so dependency cycles between chunks terminate
+            visited[index] = true;
+            pending.push_back(index);
+            stack.insert(stack.end(), m_chunks[index].deps.begin(), m_chunks[index].deps.end());
+        }
+
+        if (pending.empty())
+        {
+            return 0;
+        }
+
+        // One pass over the file in offset order
+        std::sort(pending.begin(), pending.end(), [this](size_t a, size_t b) {
+            return m_chunks[a].offset < m_chunks[b].offset;
+        });
+
+        std::vector<ProjectPart> parts(pending.size());
+        if (!decode_chunks(pending, parts))
+        {
+            mark_failed(pending);
+            return 0;
+        }
+
+        // All nodes go in before any edge, so edges between the chunks find
+        // both ends. Inserting in id order keeps the id maps appending
+        // instead of shifting their sorted arrays.
+        ProjectPart merged;
+        for (ProjectPart& part : parts)
+        {
+            merged.graph.insert(merged.graph.end(), part.graph.begin(), part.graph.end());
+            merged.nodes.insert(merged.nodes.end(), part.nodes.begin(), part.nodes.end());
+            merged.edges.insert(merged.edges.end(), part.edges.begin(), part.edges.end());
+        }
+        std::sort(merged.graph.begin(), merged.graph.end(),
+                  [](const ProjectPart::GraphNode& a, const ProjectPart::GraphNode& b) { return a.id < b.id; });
+        std::sort(merged.edges.begin(), merged.edges.end(),
+                  [](const Graph<Node>::Edge& a, const Graph<Node>::Edge& b) { return a.id < b.id; });
+
+        const size_t first_new_node = m_project->nodes.size();
+        if (!insert_project_nodes(merged, *m_project))
+        {
+            mark_failed(pending);
+            return 0;
+        }
+        for (size_t i = first_new_node; i < m_project->nodes.size(); ++i)
+        {
+            m_new_nodes.push_back(m_project->nodes[i].id);
+        }
+
+        insert_project_edges(merged, *m_project);
+        for (const size_t index : pending)
+        {
+            m_chunks[index].loaded = true;
+        }
+        return pending.size();
+    }
+
+    // Ui nodes added since the last call, e.g. to place them in the editor
+    std::vector<int> take_new_nodes()
+    {
+        std::vector<int> nodes;
+        nodes.swap(m_new_nodes);
+        return nodes;
+    }
+
+    size_t chunk_count() const { return m_chunks.size(); }
+    size_t loaded_chunk_count() const
+    {
+        return std::count_if(m_chunks.begin(), m_chunks.end(), [](const Chunk& chunk) { return chunk.loaded; });
+    }
+
+private:
+    struct Chunk
+    {
+        uint64_t            offset = 0;
+        uint64_t            size = 0;
+        float               bounds[4] = {};
+        std::vector<size_t> deps;
+        ChunkCodec          codec = ChunkCodec::none;
+        uint64_t            raw_size = 0;
+        bool                loaded = false;
+        bool                failed = false;
+    };
+
+    void mark_failed(const std::vector<size_t>& indices)
+    {
+        for (const size_t index : indices)
+        {
+            m_chunks[index].failed = true;
+        }
+        std::cerr << "Error: " << indices.size() << " project chunks could not be loaded" << std::endl;
+    }
+
+    bool read_chunk(const Chunk& chunk, std::vector<uint8_t>& bytes)
+    {
+        bytes.resize(chunk.size);
+        m_file.clear();
+        m_file.seekg(static_cast<std::streamoff>(m_data_offset + chunk.offset));
+        return read_bytes(reinterpret_cast<char*>(bytes.data()), bytes.size());
+    }
+
+    bool read_bytes(char* data, const uint64_t size)
+    {
+        m_file.read(data, static_cast<std::streamsize>(size));
+        if (m_read_callback)
+        {
+            m_read_callback(size);
+        }
+        return static_cast<bool>(m_file);
+    }
+
+    // Reads the chunks sequentially and decompresses and parses them on the
+    // thread pool while the reads continue.
+    bool decode_chunks(const std::vector<size_t>& indices, std::vector<ProjectPart>& parts)
+    {
+        if (!m_shared_decoders && !m_decoders && indices.size() > 1)
+        {
+            m_pool = std::make_unique<ThreadPool>();
+            m_decoders = m_pool.get();
+        }
+
+        std::vector<std::future<bool>> decoded;
+        bool ok = true;
+        for (size_t i = 0; i < indices.size(); ++i)
+        {
+            const Chunk& chunk = m_chunks[indices[i]];
+            std::vector<uint8_t> bytes;
+            if (!read_chunk(chunk, bytes))
+            {
+                ok = false;
+                break;
+            }
+
+            if (indices.size() == 1 || !m_decoders)
+            {
+                ok = decode_chunk(bytes, chunk.codec, chunk.raw_size, parts[i]);
+                continue;
+            }
+
+            decoded.push_back(m_decoders->submit(
+                [bytes = std::move(bytes), codec = chunk.codec, raw_size = chunk.raw_size, &part = parts[i]] {
+                    return decode_chunk(bytes, codec, raw_size, part);
+                }));
+        }
+
+        // Waits for every task, they write into parts
+        for (auto& result : decoded)
+        {
+            ok = result.get() && ok;
+        }
+        if (!ok)
+        {
+            std::cerr << "Error: cannot read project chunks" << std::endl;
+        }
+        return ok;
+    }
+
+    std::ifstream               m_file;
+    uint64_t                    m_data_offset = 0;
+    std::vector<Chunk>          m_chunks;
+    Project*                    m_project = nullptr;
+    std::vector<int>            m_new_nodes;
+    std::unique_ptr<ThreadPool> m_pool;
+    ThreadPool*                 m_decoders = nullptr;
+    bool                        m_shared_decoders = false;
+    ReadCallback                m_read_callback;
+};
+
+// Loads a whole project, chunked or plain JSON, decoding the chunks with
+// reader.
+inline bool load_project_file(Project& project, const std::string& filename, ChunkedProjectReader& reader)
+{
+    if (!is_chunked_project_file(filename))
+    {
+        return load_project_json(project, filename);
+    }
+
+    if (!reader.open(filename, project))
+    {
+        return false;
+    }
+    if (!reader.materialize_all())
+    {
+        std::cerr << "Error: cannot read all of " << filename << std::endl;
+        project = Project();
+        return false;
+    }
+    return true;
+}
+
+inline bool load_project_file(Project& project, const std::string& filename)
+{
+    ChunkedProjectReader reader;
+    return load_project_file(project, filename, reader);
+}
+
+// Decodes on decoders, or on the calling thread if it is null
+inline bool load_project_file(Project& project, const std::string& filename, ThreadPool* decoders)
+{
+    ChunkedProjectReader reader(decoders);
+    return load_project_file(project, filename, reader);
+}
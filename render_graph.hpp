@@ -0,0 +1,289 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+#include "gpu_timer.hpp"
+#include "render_target_pool.hpp"
+
+// A target declared to a RenderGraph, valid for the frame it was declared in
+struct RenderResource
+{
+    uint32_t index = ~0u;
+
+    bool valid() const { return index != ~0u; }
+};
+
+// Of the last executed frame
+struct RenderGraphStats
+{
+    size_t passes = 0;
+    size_t culled = 0;
+    size_t transients = 0;
+    // Pool targets the transients were placed in
+    size_t targets = 0;
+    // Memory of those targets, and what the transients would take each in a
+    // target of its own
+    size_t bytes = 0;
+    size_t unaliased_bytes = 0;
+};
+
+// The preview passes of a frame, declared before any of them runs. Each pass
+// names the targets it reads and writes; a pass runs only if a presented
+// target depends on what it writes, so passes without outputs never run.
+// Imported targets belong to someone else (the 3d view framebuffer, the atlas
+// pages). Transient targets live from the first to the last pass using them
+// and come from the RenderTargetPool, which hands a target released after one
+// pass to the next pass asking for the same size and format, so transients
+// whose passes do not overlap share memory. execute() runs the passes in the
+// order they were added and clears the graph for the next frame.
+class RenderGraph
+{
+public:
+    using Execute = std::function<void()>;
+
+    explicit RenderGraph(RenderTargetPool& targets) : m_targets(targets) {}
+    ~RenderGraph() { release_transients(); }
+
+    RenderGraph(const RenderGraph&) = delete;
+    RenderGraph& operator=(const RenderGraph&) = delete;
+
+    RenderResource import(const char* name)
+    {
+        Resource resource;
+        resource.name = name;
+        return add_resource(std::move(resource));
+    }
+
+    RenderResource create(const char* name, const int width, const int height, const GLenum color_format = GL_RGBA8)
+    {
+        Resource resource;
+        resource.name = name;
+        resource.transient = true;
+        resource.width = width;
+        resource.height = height;
+        resource.color_format = color_format;
+        return add_resource(std::move(resource));
+    }
+
+    void add_pass(const char* name, std::initializer_list<RenderResource> reads,
+                  std::initializer_list<RenderResource> writes, Execute execute)
+    {
+        Pass pass;
+        pass.name = name;
+        for (const RenderResource resource : reads)
+        {
+            if (resource.index < m_resources.size())
+            {
+                pass.reads.push_back(resource.index);
+            }
+        }
+        for (const RenderResource resource : writes)
+        {
+            if (resource.index < m_resources.size())
+            {
+                pass.writes.push_back(resource.index);
+            }
+        }
+        pass.execute = std::move(execute);
+        m_passes.push_back(std::move(pass));
+    }
+
+    // The target is shown this frame, the passes it depends on have to run
+    void present(const RenderResource resource)
+    {
+        if (resource.index < m_resources.size())
+        {
+            m_resources[resource.index].presented = true;
+        }
+    }
+
+    // The pool target of a transient, only while its passes run
+    RenderTargetHandle target(const RenderResource resource) const
+    {
+        return resource.index < m_resources.size() ? m_resources[resource.index].target : RenderTargetHandle();
+    }
+
+    void bind(const RenderResource resource) const { m_targets.bind(target(resource)); }
+    GLuint texture(const RenderResource resource) const { return m_targets.texture(target(resource)); }
+
+    // Measures each pass that runs with timer, if given
+    void execute(GpuTimer* timer = nullptr)
+    {
+        m_stats = RenderGraphStats();
+        cull();
+        allocate_lifetimes();
+
+        std::vector<uint32_t> used_targets;
+        for (size_t index = 0; index < m_passes.size(); ++index)
+        {
+            Pass& pass = m_passes[index];
+            if (!pass.live)
+            {
+                m_stats.culled += 1;
+                continue;
+            }
+
+            if (acquire_transients(index, used_targets))
+            {
+                const bool measured = timer && timer->begin(pass.name.c_str());
+                pass.execute();
+                if (measured)
+                {
+                    timer->end();
+                }
+                m_stats.passes += 1;
+            }
+            else
+            {
+                std::cerr << "[WARN] Render pass " << pass.name << " skipped, a target could not be allocated"
+                          << std::endl;
+            }
+
+            for (Resource& resource : m_resources)
+            {
+                if (resource.transient && resource.last == static_cast<int>(index))
+                {
+                    m_targets.release(resource.target);
+                }
+            }
+        }
+        m_stats.targets = used_targets.size();
+
+        release_transients();
+        m_passes.clear();
+        m_resources.clear();
+    }
+
+    const RenderGraphStats& stats() const { return m_stats; }
+
+private:
+    struct Resource
+    {
+        std::string        name;
+        bool               transient = false;
+        int                width = 0;
+        int                height = 0;
+        GLenum             color_format = GL_RGBA8;
+        bool               presented = false;
+        bool               needed = false;
+        // Passes using it, -1 if none runs
+        int                first = -1;
+        int                last = -1;
+        RenderTargetHandle target;
+    };
+
+    struct Pass
+    {
+        std::string           name;
+        std::vector<uint32_t> reads;
+        std::vector<uint32_t> writes;
+        Execute               execute;
+        bool                  live = false;
+    };
+
+    RenderResource add_resource(Resource resource)
+    {
+        m_resources.push_back(std::move(resource));
+        return {static_cast<uint32_t>(m_resources.size() - 1)};
+    }
+
+    // From the last pass back, a pass is live if it writes a target that is
+    // presented or read by a later live pass
+    void cull()
+    {
+        for (Resource& resource : m_resources)
+        {
+            resource.needed = resource.presented;
+        }
+        for (size_t index = m_passes.size(); index-- > 0;)
+        {
+            Pass& pass = m_passes[index];
+            pass.live = std::any_of(pass.writes.begin(), pass.writes.end(),
+                                    [this](const uint32_t resource) { return m_resources[resource].needed; });
+            if (pass.live)
+            {
+                for (const uint32_t resource : pass.reads)
+                {
+                    m_resources[resource].needed = true;
+                }
+            }
+        }
+    }
+
+    void allocate_lifetimes()
+    {
+        for (size_t index = 0; index < m_passes.size(); ++index)
+        {
+            const Pass& pass = m_passes[index];
+            if (!pass.live)
+            {
+                continue;
+            }
+            for (const std::vector<uint32_t>* list : {&pass.reads, &pass.writes})
+            {
+                for (const uint32_t resource : *list)
+                {
+                    Resource& used = m_resources[resource];
+                    if (used.first < 0)
+                    {
+                        used.first = static_cast<int>(index);
+                    }
+                    used.last = static_cast<int>(index);
+                }
+            }
+        }
+    }
+
+    // Acquires the transients first used by the pass, returns whether all of
+    // its transients have a target
+    bool acquire_transients(const size_t index, std::vector<uint32_t>& used_targets)
+    {
+        bool ok = true;
+        for (Resource& resource : m_resources)
+        {
+            if (!resource.transient || resource.first < 0 || resource.first > static_cast<int>(index) ||
+                resource.last < static_cast<int>(index))
+            {
+                continue;
+            }
+            if (resource.first == static_cast<int>(index))
+            {
+                resource.target = m_targets.acquire(resource.width, resource.height, resource.color_format);
+                if (resource.target.valid())
+                {
+                    const size_t bytes = m_targets.bytes(resource.target);
+                    m_stats.transients += 1;
+                    m_stats.unaliased_bytes += bytes;
+                    if (std::find(used_targets.begin(), used_targets.end(), resource.target.index) ==
+                        used_targets.end())
+                    {
+                        used_targets.push_back(resource.target.index);
+                        m_stats.bytes += bytes;
+                    }
+                }
+            }
+            ok = ok && resource.target.valid();
+        }
+        return ok;
+    }
+
+    void release_transients()
+    {
+        for (Resource& resource : m_resources)
+        {
+            m_targets.release(resource.target);
+        }
+    }
+
+    RenderTargetPool&     m_targets;
+    std::vector<Resource> m_resources;
+    std::vector<Pass>     m_passes;
+    RenderGraphStats      m_stats;
+};
@@ -0,0 +1,255 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include <GL/glew.h>
+
+#include "gl_state.hpp"
+
+// Refers to a render target of a RenderTargetPool. A handle whose target was
+// released stays invalid even when the target is handed out again.
+struct RenderTargetHandle
+{
+    uint32_t index = 0;
+    uint32_t generation = 0;
+
+    bool valid() const { return generation != 0; }
+};
+
+struct RenderTargetStats
+{
+    size_t   targets = 0;
+    size_t   targets_in_use = 0;
+    size_t   gpu_bytes = 0;
+    uint64_t allocations = 0;
+    uint64_t reuses = 0;
+};
+
+// Color texture with a depth buffer, handed out per preview. Requested sizes
+// are rounded up to a size class, and released targets are kept per size
+// class and color format for the next request, so deleting and adding
+// preview nodes does not allocate. Needs the GL context to be current.
+class RenderTargetPool
+{
+public:
+    // Sizes are rounded up to a multiple of this
+    static constexpr int size_step = 64;
+
+    RenderTargetPool() = default;
+    ~RenderTargetPool() { clear(); }
+
+    RenderTargetPool(const RenderTargetPool&) = delete;
+    RenderTargetPool& operator=(const RenderTargetPool&) = delete;
+
+    static int size_class(const int size) { return std::max(1, (size + size_step - 1) / size_step) * size_step; }
+
+    RenderTargetHandle acquire(const int width, const int height, const GLenum color_format = GL_RGB8)
+    {
+        const int class_width = size_class(width);
+        const int class_height = size_class(height);
+
+        for (uint32_t index = 0; index < m_targets.size(); ++index)
+        {
+            Target& target = m_targets[index];
+            if (!target.in_use && target.fbo != 0 && target.width == class_width &&
+                target.height == class_height && target.color_format == color_format)
+            {
+                target.in_use = true;
+                target.generation += 1;
+                m_stats.targets_in_use += 1;
+                m_stats.reuses += 1;
+                return {index, target.generation};
+            }
+        }
+
+        Target target;
+        target.width = class_width;
+        target.height = class_height;
+        target.color_format = color_format;
+        if (!allocate(target))
+        {
+            return {};
+        }
+        target.in_use = true;
+
+        // Reuse a slot whose target was deleted by clear()
+        auto free = std::find_if(m_targets.begin(), m_targets.end(), [](const Target& t) { return t.fbo == 0; });
+        uint32_t index;
+        if (free != m_targets.end())
+        {
+            index = static_cast<uint32_t>(free - m_targets.begin());
+            target.generation = free->generation + 1;
+            *free = target;
+        }
+        else
+        {
+            index = static_cast<uint32_t>(m_targets.size());
+            target.generation = 1;
+            m_targets.push_back(target);
+        }
+
+        m_stats.targets += 1;
+        m_stats.targets_in_use += 1;
+        m_stats.gpu_bytes += target.bytes;
+        m_stats.allocations += 1;
+        return {index, target.generation};
+    }
+
+    // The target goes back to the pool, its memory stays allocated
+    void release(RenderTargetHandle& handle)
+    {
+        if (alive(handle))
+        {
+            Target& target = m_targets[handle.index];
+            target.in_use = false;
+            target.generation += 1;
+            m_stats.targets_in_use -= 1;
+        }
+        handle = RenderTargetHandle();
+    }
+
+    bool alive(const RenderTargetHandle handle) const
+    {
+        return handle.valid() && handle.index < m_targets.size() && m_targets[handle.index].in_use &&
+               m_targets[handle.index].generation == handle.generation;
+    }
+
+    // Binding an invalid handle binds the default framebuffer
+    void bind(const RenderTargetHandle handle) const
+    {
+        GlState::instance().bind_framebuffer(GL_FRAMEBUFFER, alive(handle) ? m_targets[handle.index].fbo : 0);
+    }
+
+    GLuint texture(const RenderTargetHandle handle) const
+    {
+        return alive(handle) ? m_targets[handle.index].texture : 0;
+    }
+
+    // Allocated size, at least the requested one
+    int width(const RenderTargetHandle handle) const { return alive(handle) ? m_targets[handle.index].width : 0; }
+    int height(const RenderTargetHandle handle) const { return alive(handle) ? m_targets[handle.index].height : 0; }
+    size_t bytes(const RenderTargetHandle handle) const { return alive(handle) ? m_targets[handle.index].bytes : 0; }
+
+    // Deletes the targets nobody holds
+    void trim()
+    {
+        for (Target& target : m_targets)
+        {
+            if (!target.in_use && target.fbo != 0)
+            {
+                destroy(target);
+            }
+        }
+    }
+
+    // Deletes all targets, handles to them become invalid
+    void clear()
+    {
+        for (Target& target : m_targets)
+        {
+            if (target.fbo != 0)
+            {
+                if (target.in_use)
+                {
+                    m_stats.targets_in_use -= 1;
+                }
+                destroy(target);
+            }
+        }
+    }
+
+    const RenderTargetStats& stats() const { return m_stats; }
+
+private:
+    struct Target
+    {
+        GLuint   fbo = 0;
+        GLuint   texture = 0;
+        GLuint   depth = 0;
+        int      width = 0;
+        int      height = 0;
+        GLenum   color_format = GL_RGB8;
+        size_t   bytes = 0;
+        bool     in_use = false;
+        uint32_t generation = 0;
+    };
+
+    static size_t bytes_per_pixel(const GLenum format)
+    {
+        switch (format)
+        {
+        case GL_RGBA16F:
+            return 8;
+        case GL_RGBA32F:
+            return 16;
+        case GL_RGB16F:
+            return 6;
+        case GL_RGB8:
+        case GL_SRGB8:
+            return 3;
+        default:
+            return 4;
+        }
+    }
+
+    bool allocate(Target& target)
+    {
+        GlState& state = GlState::instance();
+        const GLuint previous_fbo = state.framebuffer();
+
+        glGenFramebuffers(1, &target.fbo);
+        state.bind_framebuffer(GL_FRAMEBUFFER, target.fbo);
+
+        glGenTextures(1, &target.texture);
+        glBindTexture(GL_TEXTURE_2D, target.texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, target.color_format, target.width, target.height, 0, GL_RGBA,
+                     GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.texture, 0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        glGenRenderbuffers(1, &target.depth);
+        glBindRenderbuffer(GL_RENDERBUFFER, target.depth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, target.width, target.height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, target.depth);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        const bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        state.bind_framebuffer(GL_FRAMEBUFFER, previous_fbo);
+
+        if (!complete)
+        {
+            std::cerr << "ERROR::FRAMEBUFFER:: Render target " << target.width << "x" << target.height
+                      << " is not complete!" << std::endl;
+            glDeleteFramebuffers(1, &target.fbo);
+            glDeleteTextures(1, &target.texture);
+            glDeleteRenderbuffers(1, &target.depth);
+            return false;
+        }
+
+        // Depth and stencil take four bytes per pixel
+        target.bytes = static_cast<size_t>(target.width) * target.height * (bytes_per_pixel(target.color_format) + 4);
+        return true;
+    }
+
+    void destroy(Target& target)
+    {
+        GlState::instance().deleted_framebuffer(target.fbo);
+        glDeleteFramebuffers(1, &target.fbo);
+        glDeleteTextures(1, &target.texture);
+        glDeleteRenderbuffers(1, &target.depth);
+
+        m_stats.targets -= 1;
+        m_stats.gpu_bytes -= target.bytes;
+
+        const uint32_t generation = target.generation + 1;
+        target = Target();
+        target.generation = generation;
+    }
+
+    std::vector<Target> m_targets;
+    RenderTargetStats   m_stats;
+};
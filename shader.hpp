@@ -1,6 +1,24 @@
 #pragma once
 
 #include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "frame_uniforms.hpp"
+#include "gl_state.hpp"
+#include "program_cache.hpp"
+#include "shader_compile_worker.hpp"
 
 enum TypeShader
 {
@@ -9,28 +27,61 @@ enum TypeShader
     GEOMETRY_SHADER = GL_GEOMETRY_SHADER
 };
 
+// 32 bit FNV-1a, usable at compile time, so uniform names in the source
+// cost no string work at runtime.
+constexpr uint32_t uniform_hash(std::string_view name)
+{
+    uint32_t hash = 2166136261u;
+    for (const char c : name)
+    {
+        hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+    }
+    return hash;
+}
+
+// A uniform name reduced to its hash. String literals convert implicitly, and
+// as constexpr variables they are hashed by the compiler.
+struct UniformName
+{
+    uint32_t hash;
+
+    constexpr UniformName(const char* name) : hash(uniform_hash(name)) {}
+    UniformName(const std::string& name) : hash(uniform_hash(name)) {}
+};
+
 class Shader
 {
 public:
 
-    Shader() : m_vertexShader(0), m_fragmentShader(0),
+    Shader() : m_id(0), m_vertexShader(0), m_fragmentShader(0),
         m_geometryShader(0), m_isVertexShader(false),
         m_isFragmentShader(false), m_isGeometryShader(false)
     { }
 
-    ~Shader() {}
+    ~Shader()
+    {
+        abandonJob();
+        // Zero names are ignored by glDelete*
+        GlState::instance().deleted_program(m_id);
+        glDeleteProgram(m_id);
+        glDeleteShader(m_vertexShader);
+        glDeleteShader(m_fragmentShader);
+        glDeleteShader(m_geometryShader);
+    }
+
+    // Owns GL objects
+    Shader(const Shader&) = delete;
+    Shader& operator=(const Shader&) = delete;
 
+    // Only keeps the source, stages are compiled by createShaderProgram
+    // unless the program binary cache already has the linked program
     void loadShader(const char *shader, TypeShader type)
     {
         if(type == TypeShader::VERTEX_SHADER)
         {
            // std::string vertexshader = getShaderReader(shader);
            // const char *vertex_shader = vertexshader.c_str();
-
-            m_vertexShader = glCreateShader(GL_VERTEX_SHADER);
-            glShaderSource(m_vertexShader, 1, &shader, NULL);
-            glCompileShader(m_vertexShader);
-            shaderCompileStatus(m_vertexShader);
+            m_sources.emplace_back(GL_VERTEX_SHADER, shader);
             m_isVertexShader = true;
         }
 
@@ -38,27 +89,20 @@ public:
         {
            // std::string fragmentshader = getShaderReader(shader);
            // const char *fragment_shader = fragmentshader.c_str();
-            m_fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-            glShaderSource(m_fragmentShader, 1, &shader, NULL);
-            glCompileShader(m_fragmentShader);
-            shaderCompileStatus(m_fragmentShader);
+            m_sources.emplace_back(GL_FRAGMENT_SHADER, shader);
             m_isFragmentShader = true;
         }
 
         if(type == TypeShader::GEOMETRY_SHADER)
         {
-            std::string geometryshader = getShaderReader(shader);
-            const char *geometry_shader = geometryshader.c_str();
-            m_geometryShader = glCreateShader(GL_GEOMETRY_SHADER);
-            glShaderSource(m_geometryShader, 1, &geometry_shader, NULL);
-            glCompileShader(m_geometryShader);
+            m_sources.emplace_back(GL_GEOMETRY_SHADER, getShaderReader(shader));
             m_isGeometryShader = true;
         }
     }
 
     void useShaderProgram()
     {
-        glUseProgram(m_id);
+        GlState::instance().use_program(m_id);
     }
 
     GLuint getShaderProgram()
@@ -66,25 +110,86 @@ public:
         return m_id;
     }
 
+    // Location of an active uniform, -1 if the program has none of that
+    // name, which glUniform* ignores. Resolve once and keep the result to
+    // skip even the table lookup.
+    GLint uniformLocation(const UniformName name) const
+    {
+        auto iter = std::lower_bound(m_uniforms.begin(), m_uniforms.end(), name.hash,
+                                     [](const Uniform& uniform, uint32_t hash) { return uniform.hash < hash; });
+        return iter != m_uniforms.end() && iter->hash == name.hash ? iter->location : -1;
+    }
+
     void createShaderProgram()
     {
-        m_id = glCreateProgram();
+        startProgram(false);
+        finishProgram();
+    }
 
-        if(m_isVertexShader)
+    // Starts compiling and linking without waiting for the driver. Poll
+    // isReady() once per frame and keep using another program until it
+    // returns true. Drivers with KHR_parallel_shader_compile compile in the
+    // background, elsewhere the ShaderCompileWorker does if it is running.
+    // Without either the wait happens in the first isReady().
+    void createShaderProgramAsync()
+    {
+        startProgram(true);
+    }
+
+    // True once the program can be used. Never blocks where parallel shader
+    // compilation is supported or the compile worker runs.
+    bool isReady()
+    {
+        if (m_job)
         {
-            glAttachShader(m_id, m_vertexShader);
+            return collectJob(false) && m_state == State::linked;
         }
-        if(m_isFragmentShader)
+
+        if (m_state == State::linking && parallelCompile())
         {
-            glAttachShader(m_id, m_fragmentShader);
+            GLint done = GL_FALSE;
+            glGetProgramiv(m_id, GL_COMPLETION_STATUS_KHR, &done);
+            if (!done)
+            {
+                return false;
+            }
         }
-        if(m_isGeometryShader)
+
+        finishProgram();
+        return m_state == State::linked;
+    }
+
+    // Blocks until the program is linked, returns false if it failed
+    bool waitReady()
+    {
+        if (m_job)
         {
-            glAttachShader(m_id, m_geometryShader);
+            collectJob(true);
         }
+        finishProgram();
+        return m_state == State::linked;
+    }
 
-        glLinkProgram(m_id);
-        programCompileStatus(m_id);
+    // True if linking is over and failed
+    bool isFailed() const { return m_state == State::failed; }
+
+    // Whether the driver compiles in the background by itself. Without it
+    // the application should start the ShaderCompileWorker.
+    static bool parallelCompile()
+    {
+        return GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile;
+    }
+
+    // Returns false if the program has no active block of that name
+    bool bindUniformBlock(const char* name, const GLuint binding)
+    {
+        const GLuint index = glGetUniformBlockIndex(m_id, name);
+        if (index == GL_INVALID_INDEX)
+        {
+            return false;
+        }
+        glUniformBlockBinding(m_id, index, binding);
+        return true;
     }
 
     std::string getShaderReader(const std::string &shader)
@@ -106,44 +211,45 @@ public:
         return contents;
     }
 
-    void setUniformMatrix4x4(const std::string &type, const glm::mat4 &matrix)
+    // The setters expect the program to be in use
+    void setUniformMatrix4x4(const UniformName type, const glm::mat4 &matrix)
     {
-        glUniformMatrix4fv(glGetUniformLocation(m_id, type.c_str()), 1, GL_FALSE, &matrix[0][0]);
+        glUniformMatrix4fv(uniformLocation(type), 1, GL_FALSE, &matrix[0][0]);
     }
 
-    void setUniformInt(const std::string &type, const GLint value)
+    void setUniformInt(const UniformName type, const GLint value)
     {
-        glUniform1i(glGetUniformLocation(m_id, type.c_str()), value);
+        glUniform1i(uniformLocation(type), value);
     }
 
-    void setUniformFloat(const std::string &type, const GLfloat value)
+    void setUniformFloat(const UniformName type, const GLfloat value)
     {
-        glUniform1f(glGetUniformLocation(m_id, type.c_str()), value);
+        glUniform1f(uniformLocation(type), value);
     }
 
-    void setUnifromVec2(const std::string &type, const glm::vec3 &value)
+    void setUnifromVec2(const UniformName type, const glm::vec3 &value)
     {
-        glUniform2f(glGetUniformLocation(m_id, type.c_str()), value.x, value.y);
+        glUniform2f(uniformLocation(type), value.x, value.y);
     }
 
-    void setUnifromVec2(const std::string &type, const float &x, const float &y)
+    void setUnifromVec2(const UniformName type, const float &x, const float &y)
     {
-        glUniform2f(glGetUniformLocation(m_id, type.c_str()), x, y);
+        glUniform2f(uniformLocation(type), x, y);
     }
 
-    void setUnifromVec3(const std::string &type, const glm::vec3 value)
+    void setUnifromVec3(const UniformName type, const glm::vec3 value)
     {
-        glUniform3fv(glGetUniformLocation(m_id, type.c_str()), 1, &value[0]);
+        glUniform3fv(uniformLocation(type), 1, &value[0]);
     }
 
-    void setUnifromVec3(const std::string &type, const float &x, const float &y, const float &z)
+    void setUnifromVec3(const UniformName type, const float &x, const float &y, const float &z)
     {
-        glUniform3f(glGetUniformLocation(m_id, type.c_str()), x, y, z);
+        glUniform3f(uniformLocation(type), x, y, z);
     }
 
 protected:
 
-    void shaderCompileStatus(GLuint shader)
+    static void shaderCompileStatus(GLuint shader)
     {
         GLint isCompiled;
 
@@ -168,7 +274,7 @@ protected:
         }
     }
 
-    void programCompileStatus(GLuint program)
+    static bool programCompileStatus(GLuint program)
     {
         GLint isCompiled;
 
@@ -191,10 +297,348 @@ protected:
                 " - Log lenght: " << logLenght <<
                 "\n";
         }
+        return isCompiled == GL_TRUE;
     }
 
 private:
 
+    enum class State
+    {
+        empty,
+        linking,
+        linked,
+        failed
+    };
+
+    // Lets the driver use as many compiler threads as it likes
+    static void enableParallelCompile()
+    {
+        static bool enabled = false;
+        if (!enabled && parallelCompile())
+        {
+            if (GLEW_KHR_parallel_shader_compile)
+            {
+                glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+            }
+            else
+            {
+                glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+            }
+        }
+        enabled = true;
+    }
+
+    // A build running on the ShaderCompileWorker. The worker creates the
+    // objects and sets done, the main thread takes them once the fence the
+    // worker put after the link has signaled.
+    struct CompileJob
+    {
+        std::mutex              mutex;
+        std::condition_variable finished;
+        bool                    done = false;
+        // The Shader was destroyed first, the worker deletes the objects
+        bool                    abandoned = false;
+        bool                    linked = false;
+        GLuint                  program = 0;
+        GLuint                  vertexShader = 0;
+        GLuint                  fragmentShader = 0;
+        GLuint                  geometryShader = 0;
+        GLsync                  fence = nullptr;
+    };
+
+    void startProgram(const bool background)
+    {
+        enableParallelCompile();
+        m_buildStart = std::chrono::steady_clock::now();
+        m_id = glCreateProgram();
+
+        ProgramBinaryCache& cache = ProgramBinaryCache::instance();
+        m_cacheKey = cache.key(m_sources);
+        if (cache.load(m_cacheKey, m_id))
+        {
+            std::cerr << "[INFO] Program loaded from cache " << m_cacheKey << "\n";
+            m_state = State::linked;
+            setupProgram(true);
+            return;
+        }
+
+        m_state = State::linking;
+        if (background && !parallelCompile() && ShaderCompileWorker::instance().running())
+        {
+            // The worker links a program of its own, objects created here
+            // are not guaranteed to be visible to its context yet
+            glDeleteProgram(m_id);
+            m_id = 0;
+            m_job = std::make_shared<CompileJob>();
+            ShaderCompileWorker::instance().submit(
+                [job = m_job, sources = m_sources] { compileOnWorker(*job, sources); });
+            return;
+        }
+
+        compileShaders();
+        if(m_isVertexShader)
+        {
+            glAttachShader(m_id, m_vertexShader);
+        }
+        if(m_isFragmentShader)
+        {
+            glAttachShader(m_id, m_fragmentShader);
+        }
+        if(m_isGeometryShader)
+        {
+            glAttachShader(m_id, m_geometryShader);
+        }
+
+        cache.prepare(m_id);
+        glLinkProgram(m_id);
+    }
+
+    // Runs on the worker thread, the status queries wait for the compiler
+    // there instead of on the main thread
+    static void compileOnWorker(CompileJob& job, const ProgramBinaryCache::Sources& sources)
+    {
+        {
+            std::lock_guard<std::mutex> lock(job.mutex);
+            if (job.abandoned)
+            {
+                job.done = true;
+                return;
+            }
+        }
+
+        GLuint vertexShader = 0;
+        GLuint fragmentShader = 0;
+        GLuint geometryShader = 0;
+        const GLuint program = glCreateProgram();
+        for (const auto& [type, source] : sources)
+        {
+            const GLuint shader = compileStage(type, source);
+            shaderCompileStatus(shader);
+            glAttachShader(program, shader);
+            if (type == GL_VERTEX_SHADER)
+            {
+                vertexShader = shader;
+            }
+            else if (type == GL_FRAGMENT_SHADER)
+            {
+                fragmentShader = shader;
+            }
+            else
+            {
+                geometryShader = shader;
+            }
+        }
+        ProgramBinaryCache::instance().prepare(program);
+        glLinkProgram(program);
+        const bool linked = programCompileStatus(program);
+
+        std::lock_guard<std::mutex> lock(job.mutex);
+        if (job.abandoned)
+        {
+            glDeleteProgram(program);
+            glDeleteShader(vertexShader);
+            glDeleteShader(fragmentShader);
+            glDeleteShader(geometryShader);
+        }
+        else
+        {
+            job.program = program;
+            job.vertexShader = vertexShader;
+            job.fragmentShader = fragmentShader;
+            job.geometryShader = geometryShader;
+            job.linked = linked;
+            job.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            // Other contexts can only wait for a fence that was flushed
+            glFlush();
+        }
+        job.done = true;
+        job.finished.notify_all();
+    }
+
+    // Takes the program of a finished job, returns false if it is not done
+    // yet. With wait it blocks until it is.
+    bool collectJob(const bool wait)
+    {
+        CompileJob& job = *m_job;
+        {
+            std::unique_lock<std::mutex> lock(job.mutex);
+            if (wait)
+            {
+                job.finished.wait(lock, [&job] { return job.done; });
+            }
+            else if (!job.done)
+            {
+                return false;
+            }
+        }
+
+        const GLuint64 timeout = wait ? 1000000000u : 0u;
+        while (glClientWaitSync(job.fence, 0, timeout) == GL_TIMEOUT_EXPIRED)
+        {
+            if (!wait)
+            {
+                return false;
+            }
+        }
+        glDeleteSync(job.fence);
+
+        m_id = job.program;
+        m_vertexShader = job.vertexShader;
+        m_fragmentShader = job.fragmentShader;
+        m_geometryShader = job.geometryShader;
+        const bool linked = job.linked;
+        m_job.reset();
+
+        if (!linked)
+        {
+            m_state = State::failed;
+            return true;
+        }
+        ProgramBinaryCache::instance().store(m_cacheKey, m_id);
+        m_state = State::linked;
+        setupProgram(false);
+        return true;
+    }
+
+    // Leaves the objects of a job that is still running to the worker
+    void abandonJob()
+    {
+        if (!m_job)
+        {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(m_job->mutex);
+        if (!m_job->done)
+        {
+            m_job->abandoned = true;
+            return;
+        }
+        glDeleteSync(m_job->fence);
+        glDeleteProgram(m_job->program);
+        glDeleteShader(m_job->vertexShader);
+        glDeleteShader(m_job->fragmentShader);
+        glDeleteShader(m_job->geometryShader);
+    }
+
+    // Waits for the link if it still runs, then reports and caches the result
+    void finishProgram()
+    {
+        if (m_state != State::linking || m_job)
+        {
+            return;
+        }
+
+        // Status queries are what waits for the compiler
+        for (const GLuint shader : {m_vertexShader, m_fragmentShader, m_geometryShader})
+        {
+            if (shader != 0)
+            {
+                shaderCompileStatus(shader);
+            }
+        }
+
+        if (!programCompileStatus(m_id))
+        {
+            m_state = State::failed;
+            return;
+        }
+
+        ProgramBinaryCache::instance().store(m_cacheKey, m_id);
+        m_state = State::linked;
+        setupProgram(false);
+    }
+
+    void setupProgram(const bool cached)
+    {
+        reflectUniforms();
+        // Every program that declares the frame block reads the shared buffer
+        bindUniformBlock("FrameData", frame_data_binding);
+        // Includes the frames an asynchronous build waited for
+        ProgramBinaryCache::instance().record(cached, std::chrono::steady_clock::now() - m_buildStart);
+    }
+
+    static GLuint compileStage(GLenum type, const std::string& source)
+    {
+        const char* text = source.c_str();
+        const GLuint shader = glCreateShader(type);
+        glShaderSource(shader, 1, &text, NULL);
+        glCompileShader(shader);
+        return shader;
+    }
+
+    void compileShaders()
+    {
+        for (const auto& [type, source] : m_sources)
+        {
+            if (type == GL_VERTEX_SHADER)
+            {
+                m_vertexShader = compileStage(type, source);
+            }
+            else if (type == GL_FRAGMENT_SHADER)
+            {
+                m_fragmentShader = compileStage(type, source);
+            }
+            else if (type == GL_GEOMETRY_SHADER)
+            {
+                m_geometryShader = compileStage(type, source);
+            }
+        }
+    }
+
+    // Builds the uniform table from the linked program. Arrays are listed as
+    // "name[0]" and are stored under "name" as well.
+    void reflectUniforms()
+    {
+        m_uniforms.clear();
+
+        GLint count = 0;
+        GLint maxLength = 0;
+        glGetProgramiv(m_id, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(m_id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+        std::vector<GLchar> buffer(std::max(maxLength, 1));
+        for (GLint i = 0; i < count; ++i)
+        {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(m_id, static_cast<GLuint>(i), static_cast<GLsizei>(buffer.size()), &length, &size,
+                               &type, buffer.data());
+            std::string name(buffer.data(), length);
+
+            // Members of uniform blocks have no location
+            const GLint location = glGetUniformLocation(m_id, name.c_str());
+            if (location < 0)
+            {
+                continue;
+            }
+
+            m_uniforms.push_back({uniform_hash(name), location});
+            if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+            {
+                m_uniforms.push_back({uniform_hash(std::string_view(name).substr(0, name.size() - 3)), location});
+            }
+        }
+
+        std::sort(m_uniforms.begin(), m_uniforms.end(),
+                  [](const Uniform& a, const Uniform& b) { return a.hash < b.hash; });
+        for (size_t i = 1; i < m_uniforms.size(); ++i)
+        {
+            if (m_uniforms[i].hash == m_uniforms[i - 1].hash)
+            {
+                std::cerr << "[WARN] Two uniforms share the hash " << m_uniforms[i].hash << "\n";
+            }
+        }
+    }
+
+    struct Uniform
+    {
+        uint32_t hash;
+        GLint    location;
+    };
+
+    std::vector<Uniform> m_uniforms;
+
     // Shader program id
     GLuint m_id;
     GLuint m_vertexShader;
@@ -204,4 +648,10 @@ private:
     bool m_isVertexShader;
     bool m_isFragmentShader;
     bool m_isGeometryShader;
+
+    ProgramBinaryCache::Sources m_sources;
+    std::string                 m_cacheKey;
+    State                       m_state = State::empty;
+    std::shared_ptr<CompileJob> m_job;
+    std::chrono::steady_clock::time_point m_buildStart;
 };
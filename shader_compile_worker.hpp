@@ -0,0 +1,58 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+
+#include "thread_pool.hpp"
+
+// A thread with its own GL context, shared with the one that draws. Where the
+// driver has no parallel shader compile, Shader compiles and links on it so
+// the frame does not wait for the compiler. The context is made current on
+// the thread by start() and released again by stop().
+class ShaderCompileWorker
+{
+public:
+    static ShaderCompileWorker& instance()
+    {
+        static ShaderCompileWorker worker;
+        return worker;
+    }
+
+    // make_current binds the shared context on the worker thread, release
+    // unbinds it. The context must not be current on any other thread.
+    void start(std::function<void()> make_current, std::function<void()> release)
+    {
+        stop();
+        m_release = std::move(release);
+        m_thread = std::make_unique<ThreadPool>(1);
+        m_thread->submit(std::move(make_current));
+    }
+
+    // Finishes the queued jobs first, the shared context can be destroyed
+    // once it returns
+    void stop()
+    {
+        if (!m_thread)
+        {
+            return;
+        }
+        if (m_release)
+        {
+            m_thread->submit(std::move(m_release));
+        }
+        m_thread.reset();
+        m_release = nullptr;
+    }
+
+    bool running() const { return m_thread != nullptr; }
+
+    // Runs job on the worker with its context current. Jobs run in order.
+    void submit(std::function<void()> job) { m_thread->submit(std::move(job)); }
+
+private:
+    ShaderCompileWorker() = default;
+    ~ShaderCompileWorker() { stop(); }
+
+    std::unique_ptr<ThreadPool> m_thread;
+    std::function<void()>       m_release;
+};
@@ -0,0 +1,453 @@
+#pragma once
+
+// Include with STB_IMAGE_IMPLEMENTATION defined in one translation unit.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <GL/glew.h>
+
+#include "3rdparty/stb_image.h"
+#include "thread_pool.hpp"
+
+enum class TextureState
+{
+    loading,
+    ready,
+    failed
+};
+
+struct TextureLibraryStats
+{
+    size_t   textures = 0;
+    size_t   loading = 0;
+    // Textures shown at low resolution after they were evicted
+    size_t   evicted = 0;
+    size_t   gpu_bytes = 0;
+    size_t   budget_bytes = 0;
+    // Requests that found the texture at full resolution, or not
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    uint64_t uploads = 0;
+    double   decode_milliseconds = 0.0;
+    double   upload_milliseconds = 0.0;
+};
+
+// The images of texture nodes, one GL texture per file however many nodes
+// use it. Files are decoded on worker threads and poll() uploads the decoded
+// ones on the GL thread, each in a single step that also builds its mipmaps,
+// so the editor never waits for image I/O.
+//
+// Textures share a memory budget. Once it is exceeded, poll() replaces the
+// least recently used textures by small copies kept from decoding, and a
+// later request decodes them again at full resolution.
+class TextureLibrary
+{
+public:
+    struct Entry
+    {
+        TextureState state = TextureState::loading;
+        GLuint       texture = 0;
+        // Size of the image, also while a smaller copy is shown
+        int          width = 0;
+        int          height = 0;
+        // False while the low resolution copy of an evicted texture is shown
+        bool         full_resolution = false;
+        // Mean brightness of the image in [0, 1]
+        float        mean = 0.f;
+        std::string  error;
+    };
+
+    // Decoded images uploaded by one poll(), at least one is always uploaded
+    static constexpr size_t upload_bytes_per_poll = 32u << 20;
+    // Longest side of the copy kept for evicted textures
+    static constexpr int    low_resolution_size = 64;
+
+    // The budget is $MATERIALEDITOR_TEXTURE_BUDGET_MB or 512 MiB
+    explicit TextureLibrary(size_t threads = 2) : m_threads(threads)
+    {
+        const char* budget = std::getenv("MATERIALEDITOR_TEXTURE_BUDGET_MB");
+        const long megabytes = budget ? std::strtol(budget, nullptr, 10) : 0;
+        m_stats.budget_bytes = (megabytes > 0 ? static_cast<size_t>(megabytes) : 512u) << 20;
+    }
+
+    ~TextureLibrary()
+    {
+        // Only the decodes already running are waited for
+        clear();
+        m_pool.reset();
+        glDeleteBuffers(1, &m_pixelBuffer);
+    }
+
+    TextureLibrary(const TextureLibrary&) = delete;
+    TextureLibrary& operator=(const TextureLibrary&) = delete;
+
+    // Uploads through a pixel buffer, so the driver copies the image while
+    // the next one is decoded. On by default.
+    void set_use_pixel_buffer(const bool use) { m_usePixelBuffer = use; }
+
+    // Takes effect in the next poll()
+    void set_budget(const size_t bytes) { m_stats.budget_bytes = bytes; }
+    size_t budget() const { return m_stats.budget_bytes; }
+
+    // Starts decoding path unless it is loaded or loading already. Textures
+    // that are requested with used set are not evicted in the next poll(),
+    // and evicted ones are decoded again; a caller that only needs the state
+    // of an image that is not on screen passes false. The entry stays valid
+    // until clear().
+    const Entry& request(const std::string& path, const bool used = true)
+    {
+        auto iter = m_entries.find(path);
+        if (iter != m_entries.end())
+        {
+            Loaded& loaded = iter->second;
+            if (used)
+            {
+                loaded.last_used = m_frame;
+                if (loaded.entry.state == TextureState::ready)
+                {
+                    (loaded.entry.full_resolution ? m_stats.hits : m_stats.misses) += 1;
+                    if (!loaded.entry.full_resolution && !loaded.image.valid() && !loaded.reload_failed)
+                    {
+                        start_decode(path, loaded);
+                    }
+                }
+            }
+            return loaded.entry;
+        }
+
+        Loaded& loaded = m_entries[path];
+        loaded.last_used = m_frame;
+        if (path.empty())
+        {
+            loaded.entry.state = TextureState::failed;
+            loaded.entry.error = "no file";
+            return loaded.entry;
+        }
+
+        m_stats.misses += 1;
+        start_decode(path, loaded);
+        return loaded.entry;
+    }
+
+    // Uploads decoded images, up to upload_bytes_per_poll, then evicts
+    // textures until the budget is met. Call once per frame before the
+    // requests. Returns whether any entry changed.
+    bool poll(const bool wait = false)
+    {
+        bool changed = false;
+        size_t uploaded = 0;
+        for (auto& [path, loaded] : m_entries)
+        {
+            if (!loaded.image.valid())
+            {
+                continue;
+            }
+            if (!wait && (uploaded >= upload_bytes_per_poll ||
+                          loaded.image.wait_for(std::chrono::seconds(0)) != std::future_status::ready))
+            {
+                continue;
+            }
+
+            const std::unique_ptr<Image> image = loaded.image.get();
+            changed = true;
+            m_stats.decode_milliseconds += image->milliseconds;
+            if (!image->pixels)
+            {
+                std::cerr << "[WARN] Cannot load texture " << path << ": " << image->error << "\n";
+                if (loaded.entry.state == TextureState::loading)
+                {
+                    loaded.entry.state = TextureState::failed;
+                    loaded.entry.error = image->error;
+                }
+                // An evicted texture whose file went away keeps its copy
+                loaded.reload_failed = true;
+                continue;
+            }
+
+            upload(loaded, *image);
+            uploaded += static_cast<size_t>(image->width) * image->height * 4;
+        }
+
+        changed = evict() || changed;
+        m_frame += 1;
+        return changed;
+    }
+
+    // Deletes all textures and forgets failed files, so they are read again
+    void clear()
+    {
+        if (m_pool)
+        {
+            // Queued decodes never start, running ones finish in the
+            // background into futures that are dropped unread
+            m_pool->discard_pending();
+        }
+        for (auto& [path, loaded] : m_entries)
+        {
+            glDeleteTextures(1, &loaded.entry.texture);
+        }
+        m_entries.clear();
+        m_stats.gpu_bytes = 0;
+    }
+
+    // Whether images are still decoding, so a later poll() has work to do
+    bool busy() const
+    {
+        return std::any_of(m_entries.begin(), m_entries.end(),
+                           [](const auto& entry) { return entry.second.image.valid(); });
+    }
+
+    const TextureLibraryStats& stats()
+    {
+        m_stats.textures = 0;
+        m_stats.loading = 0;
+        m_stats.evicted = 0;
+        for (const auto& [path, loaded] : m_entries)
+        {
+            m_stats.textures += loaded.entry.state == TextureState::ready ? 1 : 0;
+            m_stats.loading += loaded.entry.state == TextureState::loading ? 1 : 0;
+            m_stats.evicted += loaded.entry.state == TextureState::ready && !loaded.entry.full_resolution ? 1 : 0;
+        }
+        return m_stats;
+    }
+
+private:
+    struct ImageDeleter
+    {
+        void operator()(unsigned char* pixels) const { stbi_image_free(pixels); }
+    };
+
+    struct Image
+    {
+        std::unique_ptr<unsigned char, ImageDeleter> pixels;
+        int         width = 0;
+        int         height = 0;
+        float       mean = 0.f;
+        // Box filtered copy of at most low_resolution_size pixels a side
+        std::vector<unsigned char> low;
+        int         low_width = 0;
+        int         low_height = 0;
+        std::string error;
+        double      milliseconds = 0.0;
+    };
+
+    struct Loaded
+    {
+        Entry                               entry;
+        std::future<std::unique_ptr<Image>> image;
+        // Value of m_frame when last requested with used set
+        uint64_t                            last_used = 0;
+        // Memory of the texture that is uploaded now
+        size_t                              bytes = 0;
+        std::vector<unsigned char>          low;
+        int                                 low_width = 0;
+        int                                 low_height = 0;
+        bool                                reload_failed = false;
+    };
+
+    void start_decode(const std::string& path, Loaded& loaded)
+    {
+        if (!m_pool)
+        {
+            m_pool = std::make_unique<ThreadPool>(m_threads);
+        }
+        loaded.image = m_pool->submit([path] { return decode(path); });
+    }
+
+    // Runs on a worker, decodes to RGBA8 with the first row at the top
+    static std::unique_ptr<Image> decode(const std::string& path)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        auto image = std::make_unique<Image>();
+        int channels = 0;
+        image->pixels.reset(stbi_load(path.c_str(), &image->width, &image->height, &channels, 4));
+        if (!image->pixels)
+        {
+            image->error = stbi_failure_reason() ? stbi_failure_reason() : "cannot decode";
+        }
+        else
+        {
+            const size_t count = static_cast<size_t>(image->width) * image->height;
+            const unsigned char* pixel = image->pixels.get();
+            uint64_t sum = 0;
+            for (size_t i = 0; i < count; ++i, pixel += 4)
+            {
+                sum += 54u * pixel[0] + 183u * pixel[1] + 19u * pixel[2];
+            }
+            image->mean = count > 0 ? static_cast<float>(sum / (255.0 * 256.0 * count)) : 0.f;
+            shrink(*image);
+        }
+        image->milliseconds =
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return image;
+    }
+
+    // Averages blocks of step x step pixels into image.low
+    static void shrink(Image& image)
+    {
+        const int step = std::max(1, (std::max(image.width, image.height) + low_resolution_size - 1) /
+                                         low_resolution_size);
+        image.low_width = std::max(1, image.width / step);
+        image.low_height = std::max(1, image.height / step);
+        image.low.assign(static_cast<size_t>(image.low_width) * image.low_height * 4, 0);
+
+        for (int y = 0; y < image.low_height; ++y)
+        {
+            for (int x = 0; x < image.low_width; ++x)
+            {
+                uint32_t sum[4] = {0, 0, 0, 0};
+                uint32_t count = 0;
+                for (int sy = y * step; sy < std::min(image.height, (y + 1) * step); ++sy)
+                {
+                    for (int sx = x * step; sx < std::min(image.width, (x + 1) * step); ++sx)
+                    {
+                        const unsigned char* pixel =
+                            image.pixels.get() + (static_cast<size_t>(sy) * image.width + sx) * 4;
+                        for (int c = 0; c < 4; ++c)
+                        {
+                            sum[c] += pixel[c];
+                        }
+                        count += 1;
+                    }
+                }
+                unsigned char* out = &image.low[(static_cast<size_t>(y) * image.low_width + x) * 4];
+                for (int c = 0; c < 4; ++c)
+                {
+                    out[c] = static_cast<unsigned char>(sum[c] / std::max(count, 1u));
+                }
+            }
+        }
+    }
+
+    void upload(Loaded& loaded, Image& image)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        Entry& entry = loaded.entry;
+        release(loaded);
+
+        entry.texture = create_texture(image.pixels.get(), image.width, image.height, m_usePixelBuffer);
+        entry.state = TextureState::ready;
+        entry.full_resolution = true;
+        entry.width = image.width;
+        entry.height = image.height;
+        entry.mean = image.mean;
+        loaded.low = std::move(image.low);
+        loaded.low_width = image.low_width;
+        loaded.low_height = image.low_height;
+
+        // The mip chain adds a third
+        loaded.bytes = static_cast<size_t>(image.width) * image.height * 4 * 4 / 3;
+        m_stats.gpu_bytes += loaded.bytes;
+        m_stats.uploads += 1;
+        m_stats.upload_milliseconds +=
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void release(Loaded& loaded)
+    {
+        glDeleteTextures(1, &loaded.entry.texture);
+        loaded.entry.texture = 0;
+        m_stats.gpu_bytes -= loaded.bytes;
+        loaded.bytes = 0;
+    }
+
+    // Swaps full resolution textures that were not requested since the last
+    // poll for their low resolution copy, least recently used first
+    bool evict()
+    {
+        if (m_stats.gpu_bytes <= m_stats.budget_bytes)
+        {
+            return false;
+        }
+
+        std::vector<Loaded*> candidates;
+        for (auto& [path, loaded] : m_entries)
+        {
+            if (loaded.entry.full_resolution && loaded.last_used != m_frame && !loaded.low.empty())
+            {
+                candidates.push_back(&loaded);
+            }
+        }
+        std::sort(candidates.begin(), candidates.end(),
+                  [](const Loaded* a, const Loaded* b) { return a->last_used < b->last_used; });
+
+        bool evicted = false;
+        for (Loaded* loaded : candidates)
+        {
+            if (m_stats.gpu_bytes <= m_stats.budget_bytes)
+            {
+                break;
+            }
+            release(*loaded);
+            loaded->entry.texture = create_texture(loaded->low.data(), loaded->low_width, loaded->low_height, false);
+            loaded->entry.full_resolution = false;
+            loaded->bytes = static_cast<size_t>(loaded->low_width) * loaded->low_height * 4 * 4 / 3;
+            m_stats.gpu_bytes += loaded->bytes;
+            m_stats.evictions += 1;
+            evicted = true;
+        }
+        return evicted;
+    }
+
+    GLuint create_texture(const unsigned char* pixels, const int width, const int height, const bool use_pixel_buffer)
+    {
+        const size_t bytes = static_cast<size_t>(width) * height * 4;
+        GLuint texture = 0;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+        bool uploaded = false;
+        if (use_pixel_buffer)
+        {
+            if (m_pixelBuffer == 0)
+            {
+                glGenBuffers(1, &m_pixelBuffer);
+            }
+            // Orphaned per upload, so a previous copy does not have to finish
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_pixelBuffer);
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+            void* data = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes,
+                                          GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+            if (data)
+            {
+                std::memcpy(data, pixels, bytes);
+                glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+                uploaded = true;
+            }
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+        if (!uploaded)
+        {
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+        }
+
+        // Built once here, node previews show the images minified
+        glGenerateMipmap(GL_TEXTURE_2D);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return texture;
+    }
+
+    size_t                                  m_threads;
+    std::unique_ptr<ThreadPool>             m_pool;
+    std::unordered_map<std::string, Loaded> m_entries;
+    GLuint                                  m_pixelBuffer = 0;
+    bool                                    m_usePixelBuffer = true;
+    uint64_t                                m_frame = 1;
+    TextureLibraryStats                     m_stats;
+};
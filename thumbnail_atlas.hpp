@@ -0,0 +1,409 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "object.hpp"
+#include "shader.hpp"
+#include "preview.hpp"
+#include "render_target_pool.hpp"
+#include "gl_state.hpp"
+
+struct ThumbnailStats
+{
+    size_t   slots_in_use = 0;
+    size_t   pages = 0;
+    // Of the last flush
+    size_t   thumbnails_drawn = 0;
+    size_t   draw_calls = 0;
+    uint64_t flushes = 0;
+};
+
+// Keeps the previews of many nodes in cells of shared atlas pages. Previews
+// are requested while the nodes are drawn and flush() renders all changed
+// ones together: per page one instanced draw clears their cells and one
+// draws each mesh shown in them, however many previews changed.
+class ThumbnailAtlas
+{
+public:
+    static constexpr int cell_size = 256;
+    // Smallest size a preview is drawn at, see the size of the keys
+    static constexpr int min_size = 32;
+    static constexpr int page_cells = 4;
+    static constexpr int page_size = cell_size * page_cells;
+
+    struct Region
+    {
+        GLuint    texture = 0;
+        glm::vec2 uv0 = glm::vec2(0.f);
+        glm::vec2 uv1 = glm::vec2(0.f);
+    };
+
+    // Uses the meshes of renderer and takes its pages from targets, both
+    // have to outlive the atlas
+    ThumbnailAtlas(PreviewRenderer& renderer, RenderTargetPool& targets)
+        : m_renderer(renderer), m_targets(targets)
+    {
+        const float quad[] = {-1.f, -1.f, 0.f, 1.f, -1.f, 0.f, 1.f, 1.f, 0.f,
+                              -1.f, -1.f, 0.f, 1.f, 1.f,  0.f, -1.f, 1.f, 0.f};
+        m_quad = m_renderer.meshes().create(quad, sizeof(quad), 3 * sizeof(float), {{0, 3, 0}}, GL_TRIANGLES);
+        glGenBuffers(1, &m_instanceBuffer);
+
+        m_shader.loadShader(shaderThumbnailVertex, TypeShader::VERTEX_SHADER);
+        m_shader.loadShader(shaderThumbnailFragment, TypeShader::FRAGMENT_SHADER);
+        m_shader.createShaderProgramAsync();
+    }
+
+    ~ThumbnailAtlas()
+    {
+        glDeleteBuffers(1, &m_instanceBuffer);
+        m_renderer.meshes().destroy(m_quad);
+        for (RenderTargetHandle& page : m_pages)
+        {
+            m_targets.release(page);
+        }
+    }
+
+    ThumbnailAtlas(const ThumbnailAtlas&) = delete;
+    ThumbnailAtlas& operator=(const ThumbnailAtlas&) = delete;
+
+    // The key a preview of the atlas is drawn with. Previews are drawn at
+    // size pixels, clamped to the cell, into the lower left of their cell;
+    // the region of a smaller one covers only that part.
+    PreviewKey cube_key(glm::vec3 color, float rotationX, float rotationY, int size = cell_size) const
+    {
+        size = clamp_size(size);
+        return m_renderer.cube_key(color, rotationX, rotationY, size, size);
+    }
+
+    PreviewKey sphere_key(glm::vec3 color, int size = cell_size) const
+    {
+        size = clamp_size(size);
+        return m_renderer.sphere_key(color, size, size);
+    }
+
+    PreviewKey mesh_key(glm::vec3 color, float rotationX, float rotationY, MeshHandle mesh, glm::vec4 fit,
+                        int size = cell_size) const
+    {
+        size = clamp_size(size);
+        return m_renderer.mesh_key(color, rotationX, rotationY, mesh, fit, size, size);
+    }
+
+    static int clamp_size(const int size) { return std::clamp(size, min_size, cell_size); }
+
+    // Gives the node a cell if it has none and queues a redraw if key
+    // differs from what the cell shows. The returned region is valid for the
+    // rest of the frame and shows key after the next flush().
+    Region request(const int node_id, const PreviewKey& key)
+    {
+        auto iter = m_slots.find(node_id);
+        if (iter == m_slots.end())
+        {
+            iter = m_slots.emplace(node_id, Slot{allocate_cell(), PreviewKey(), false}).first;
+        }
+
+        Slot& slot = iter->second;
+        if (slot.key != key)
+        {
+            slot.key = key;
+            slot.placeholder = false;
+            m_pending.push_back(node_id);
+        }
+
+        return region(slot.cell, slot.key.width);
+    }
+
+    void release(const int node_id)
+    {
+        auto iter = m_slots.find(node_id);
+        if (iter != m_slots.end())
+        {
+            m_freeCells.push_back(iter->second.cell);
+            m_slots.erase(iter);
+        }
+    }
+
+    // Frees all cells, the pages stay allocated for the next project
+    void release_all()
+    {
+        m_slots.clear();
+        m_pending.clear();
+        m_freeCells.clear();
+        for (int cell = static_cast<int>(m_pages.size()) * page_cells * page_cells - 1; cell >= 0; --cell)
+        {
+            m_freeCells.push_back(cell);
+        }
+    }
+
+    // Draws the previews requested since the last flush. While the program
+    // still compiles they stay queued and their cells are drawn once with
+    // the placeholder program of the renderer.
+    void flush()
+    {
+        m_stats.thumbnails_drawn = 0;
+        m_stats.draw_calls = 0;
+        if (m_pending.empty())
+        {
+            return;
+        }
+        if (!program_ready())
+        {
+            draw_placeholders();
+            return;
+        }
+
+        std::sort(m_pending.begin(), m_pending.end());
+        m_pending.erase(std::unique(m_pending.begin(), m_pending.end()), m_pending.end());
+
+        // Instances grouped by page and, within a page, by mesh
+        struct Pending
+        {
+            int        page;
+            MeshHandle mesh;
+            Instance   instance;
+        };
+        std::vector<Pending> pending;
+        for (const int node_id : m_pending)
+        {
+            auto iter = m_slots.find(node_id);
+            if (iter == m_slots.end())
+            {
+                continue;
+            }
+            const Slot& slot = iter->second;
+            pending.push_back({slot.cell / (page_cells * page_cells), m_renderer.mesh_of(slot.key),
+                               instance(slot.cell, slot.key)});
+        }
+        m_pending.clear();
+
+        std::stable_sort(pending.begin(), pending.end(), [](const Pending& a, const Pending& b) {
+            if (a.page != b.page)
+            {
+                return a.page < b.page;
+            }
+            return a.mesh.index != b.mesh.index ? a.mesh.index < b.mesh.index
+                                                : a.mesh.generation < b.mesh.generation;
+        });
+
+        std::vector<Instance> instances;
+        instances.reserve(pending.size());
+        for (const Pending& entry : pending)
+        {
+            instances.push_back(entry.instance);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+        glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(Instance), instances.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        GlState& state = GlState::instance();
+        const GLuint previous_fbo = state.framebuffer();
+
+        m_renderer.set_frame(cell_size, cell_size);
+        m_shader.useShaderProgram();
+        glUniform3f(m_backgroundColorLocation, 0.1f, 0.1f, 0.1f);
+        state.viewport(0, 0, page_size, page_size);
+        state.enable(GL_DEPTH_TEST);
+        for (int plane = 0; plane < 4; ++plane)
+        {
+            state.enable(GL_CLIP_DISTANCE0 + plane);
+        }
+
+        size_t begin = 0;
+        while (begin < pending.size())
+        {
+            const int page = pending[begin].page;
+            size_t end = begin;
+            while (end < pending.size() && pending[end].page == page)
+            {
+                ++end;
+            }
+
+            m_targets.bind(m_pages[page]);
+
+            // Cells are cleared by drawing their background at the far plane
+            state.depth_func(GL_ALWAYS);
+            glUniform1i(m_backgroundLocation, 1);
+            draw(m_quad, begin, end - begin);
+
+            state.depth_func(GL_LESS);
+            glUniform1i(m_backgroundLocation, 0);
+            for (size_t first = begin; first < end;)
+            {
+                size_t last = first + 1;
+                while (last < end && pending[last].mesh.index == pending[first].mesh.index &&
+                       pending[last].mesh.generation == pending[first].mesh.generation)
+                {
+                    ++last;
+                }
+                // Meshes still loading draw nothing and keep the background
+                draw(pending[first].mesh, first, last - first);
+                first = last;
+            }
+
+            begin = end;
+        }
+
+        for (int plane = 0; plane < 4; ++plane)
+        {
+            state.disable(GL_CLIP_DISTANCE0 + plane);
+        }
+        state.bind_framebuffer(GL_FRAMEBUFFER, previous_fbo);
+
+        m_stats.thumbnails_drawn = pending.size();
+        m_stats.flushes += 1;
+    }
+
+    // Whether previews wait for the program, a later flush() draws them
+    bool has_pending() const { return !m_pending.empty(); }
+
+    const ThumbnailStats& stats()
+    {
+        m_stats.slots_in_use = m_slots.size();
+        m_stats.pages = m_pages.size();
+        return m_stats;
+    }
+
+private:
+    struct Slot
+    {
+        int        cell;
+        PreviewKey key;
+        // The cell shows key drawn with the placeholder program
+        bool       placeholder;
+    };
+
+    struct Instance
+    {
+        float cell[4];
+        float color[3];
+        float rotation[2];
+        float fit[4];
+    };
+
+    static std::vector<VertexAttribute> instance_layout()
+    {
+        return {{3, 4, offsetof(Instance, cell)}, {4, 3, offsetof(Instance, color)},
+                {5, 2, offsetof(Instance, rotation)}, {6, 4, offsetof(Instance, fit)}};
+    }
+
+    // Maps the clip space of a cell, or of its lower left part for a
+    // smaller preview, into the clip space of its page
+    static Instance instance(const int cell, const PreviewKey& key)
+    {
+        const int index = cell % (page_cells * page_cells);
+        const float scale = float(clamp_size(key.width)) / cell_size / page_cells;
+        const float x = -1.f + 2.f * float(index % page_cells) / page_cells + scale;
+        const float y = -1.f + 2.f * float(index / page_cells) / page_cells + scale;
+        return {{x, y, scale, scale},
+                {key.color.r, key.color.g, key.color.b},
+                {key.rotationX, key.rotationY},
+                {key.fit.x, key.fit.y, key.fit.z, key.fit.w}};
+    }
+
+    void draw(const MeshHandle mesh, const size_t first, const size_t count)
+    {
+        if (count == 0 || !m_renderer.meshes().alive(mesh))
+        {
+            return;
+        }
+        m_renderer.meshes().attach_instance_attributes(mesh, m_instanceBuffer, sizeof(Instance), instance_layout(),
+                                                       first * sizeof(Instance));
+        m_renderer.meshes().draw_instanced(mesh, static_cast<GLsizei>(count));
+        m_renderer.meshes().detach_instance_attributes(mesh, instance_layout());
+        m_stats.draw_calls += 1;
+    }
+
+    // One draw per cell, only while the atlas program compiles
+    void draw_placeholders()
+    {
+        GlState& state = GlState::instance();
+        const GLuint previous_fbo = state.framebuffer();
+        int bound_page = -1;
+        for (const int node_id : m_pending)
+        {
+            auto iter = m_slots.find(node_id);
+            if (iter == m_slots.end() || iter->second.placeholder)
+            {
+                continue;
+            }
+            Slot& slot = iter->second;
+            const int page = slot.cell / (page_cells * page_cells);
+            const int index = slot.cell % (page_cells * page_cells);
+            if (page != bound_page)
+            {
+                m_targets.bind(m_pages[page]);
+                bound_page = page;
+            }
+            m_renderer.render_placeholder(slot.key, (index % page_cells) * cell_size,
+                                          (index / page_cells) * cell_size);
+            slot.placeholder = true;
+            m_stats.draw_calls += 1;
+        }
+        state.bind_framebuffer(GL_FRAMEBUFFER, previous_fbo);
+    }
+
+    bool program_ready()
+    {
+        if (m_backgroundLocation < 0 && m_shader.isReady())
+        {
+            m_backgroundLocation = m_shader.uniformLocation("background");
+            m_backgroundColorLocation = m_shader.uniformLocation("backgroundColor");
+        }
+        return m_backgroundLocation >= 0;
+    }
+
+    int allocate_cell()
+    {
+        if (m_freeCells.empty())
+        {
+            const int first = static_cast<int>(m_pages.size()) * page_cells * page_cells;
+            m_pages.push_back(m_targets.acquire(page_size, page_size, GL_RGBA8));
+
+            // Cells show the background until their preview is drawn
+            const GLuint previous_fbo = GlState::instance().framebuffer();
+            m_targets.bind(m_pages.back());
+            glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            GlState::instance().bind_framebuffer(GL_FRAMEBUFFER, previous_fbo);
+            for (int cell = first + page_cells * page_cells - 1; cell >= first; --cell)
+            {
+                m_freeCells.push_back(cell);
+            }
+        }
+
+        const int cell = m_freeCells.back();
+        m_freeCells.pop_back();
+        return cell;
+    }
+
+    Region region(const int cell, const int size) const
+    {
+        const int page = cell / (page_cells * page_cells);
+        const int index = cell % (page_cells * page_cells);
+        const float scale = 1.f / page_cells;
+        const float used = scale * clamp_size(size) / cell_size;
+        Region region;
+        region.texture = m_targets.texture(m_pages[page]);
+        region.uv0 = glm::vec2((index % page_cells) * scale, (index / page_cells) * scale);
+        region.uv1 = glm::vec2(region.uv0.x + used, region.uv0.y + used);
+        return region;
+    }
+
+    PreviewRenderer&                m_renderer;
+    RenderTargetPool&               m_targets;
+    Shader                          m_shader;
+    MeshHandle                      m_quad;
+    GLuint                          m_instanceBuffer = 0;
+    GLint                           m_backgroundLocation = -1;
+    GLint                           m_backgroundColorLocation = -1;
+    std::vector<RenderTargetHandle> m_pages;
+    std::vector<int>                m_freeCells;
+    std::unordered_map<int, Slot>   m_slots;
+    std::vector<int>                m_pending;
+    ThumbnailStats                  m_stats;
+};